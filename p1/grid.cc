@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include "grid.h"
 
 void GRID::read_from_file(
@@ -71,39 +72,141 @@ void GRID::read_from_file(
   init();
 }
 
+void GRID::compute_edge_table()
+{
+  const int nn = this->num_nodes();
+  const int nt = this->num_triangles();
+
+  // Every side of a triangle is stored in the row of its smaller node.
+  // Count the sides per row to get an upper bound for the row lengths
+  // (interior edges are counted twice).
+  std::vector<int> row_start(nn + 1, 0);
+  for (int t_id = 0; t_id < nt; t_id++)
+  {
+    const Triangle &t = conn_[t_id];
+    for (int v = 0; v < NODES_PER_TRIANGLE; v++)
+    {
+      ++row_start[std::min(t[v], t[(v + 1) % NODES_PER_TRIANGLE]) + 1];
+    }
+  }
+  for (int v = 0; v < nn; v++)
+  {
+    row_start[v + 1] += row_start[v];
+  }
+
+  // preliminary rows, filled up to row_len[v]
+  std::vector<int> row_len(nn, 0);
+  std::vector<int> target(row_start[nn]);
+  std::vector<int> index(row_start[nn]);
+
+  tri_edges_.resize(NODES_PER_TRIANGLE * nt);
+  edge_nodes_.clear();
+  edge_nodes_.reserve(2 * (nn + nt));
+
+  // an edge gets a new number when it is met for the first time
+  int ne = 0;
+  for (int t_id = 0; t_id < nt; t_id++)
+  {
+    const Triangle &t = conn_[t_id];
+    for (int v = 0; v < NODES_PER_TRIANGLE; v++)
+    {
+      const int v_start_id = t[v];
+      const int v_end_id = t[(v + 1) % NODES_PER_TRIANGLE];
+      const int lo = std::min(v_start_id, v_end_id);
+      const int hi = std::max(v_start_id, v_end_id);
+
+      // search edge in row of lo
+      const int begin = row_start[lo];
+      const int end = begin + row_len[lo];
+      int e = -1;
+      for (int k = begin; k < end; k++)
+      {
+        if (target[k] == hi)
+        {
+          e = index[k];
+          break;
+        }
+      }
+
+      if (e < 0)
+      {
+        e = ne++;
+        target[end] = hi;
+        index[end] = e;
+        ++row_len[lo];
+        edge_nodes_.push_back(v_start_id);
+        edge_nodes_.push_back(v_end_id);
+      }
+      tri_edges_[NODES_PER_TRIANGLE * t_id + v] = e;
+    }
+  }
+
+  // compress rows
+  edge_ptr_.resize(nn + 1);
+  int pos = 0;
+  for (int v = 0; v < nn; v++)
+  {
+    edge_ptr_[v] = pos;
+    for (int k = row_start[v]; k < row_start[v] + row_len[v]; k++, pos++)
+    {
+      target[pos] = target[k];
+      index[pos] = index[k];
+    }
+  }
+  edge_ptr_[nn] = pos;
+  target.resize(ne);
+  index.resize(ne);
+  edge_target_.swap(target);
+  edge_index_.swap(index);
+  edge_nodes_.shrink_to_fit();
+}
+
 void GRID::refine_ip(
     const FE_VEC in[],
     int num_vec,
     GRID &newgrid,
     FE_VEC out[])
 {
+  // (re)build edge table if necessary
+  if (static_cast<int>(tri_edges_.size()) != NODES_PER_TRIANGLE * this->num_triangles())
+  {
+    compute_edge_table();
+  }
+
+  const int nn = this->num_nodes();
+  const int ne = this->num_edges();
+  const int nt = this->num_triangles();
+
+  // the vertex in the middle of edge e gets the id nn + e in the new grid
+  refinement_info_.resize(ne);
+  for (int e = 0; e < ne; e++)
+  {
+    refinement_info_[e] = nn + e;
+  }
+
+  newgrid.reserve(4 * nt, nn + ne);
+
   //add all current vertices to new grid and therfore keep ids the same
-  for (int v = 0; v < this->num_nodes(); v++)
+  for (int v = 0; v < nn; v++)
   {
     newgrid.add_vertex(this->get_coordinates(v));
   }
+  // add the vertex in the middle of every edge
+  for (int e = 0; e < ne; e++)
+  {
+    Coord &v_start = this->get_coordinates(edge_nodes_[2 * e]);
+    Coord &v_end = this->get_coordinates(edge_nodes_[2 * e + 1]);
+    Coord new_vertex = v_start + (v_end - v_start) * (1. / 2.);
+    newgrid.add_vertex(new_vertex);
+  }
   // iterate over all triangles and add 4 new
-  for (int t_id = 0; t_id < this->num_triangles(); t_id++)
+  for (int t_id = 0; t_id < nt; t_id++)
   {
     Triangle current_triangle = this->get_triangle(t_id);
-    // first add the new vertices for every edge of triangle if not already
-    for (int v = 0; v < NODES_PER_TRIANGLE; v++)
-    {
-      int v_start_id = current_triangle[v];
-      int v_end_id = current_triangle[(v + 1) % NODES_PER_TRIANGLE];
-      int edge_index = this->edge_id(v_start_id, v_end_id);
-      if (refinement_info_.find(edge_index) == refinement_info_.end())
-      {
-        // compute vertex in the middle
-        Coord new_vertex = this->get_coordinates(v_start_id) + (this->get_coordinates(v_end_id) - this->get_coordinates(v_start_id)) * (1. / 2.);
-        newgrid.add_vertex(new_vertex);
-        refinement_info_[edge_index] = newgrid.num_nodes() - 1;
-      }
-    }
     // add four triangles:
-    int a = refinement_info_[this->edge_id(current_triangle[0], current_triangle[1])];
-    int b = refinement_info_[this->edge_id(current_triangle[2], current_triangle[0])];
-    int c = refinement_info_[this->edge_id(current_triangle[1], current_triangle[2])];
+    int a = refinement_info_[tri_edges_[NODES_PER_TRIANGLE * t_id]];
+    int c = refinement_info_[tri_edges_[NODES_PER_TRIANGLE * t_id + 1]];
+    int b = refinement_info_[tri_edges_[NODES_PER_TRIANGLE * t_id + 2]];
     Triangle A(current_triangle[0], a, b);
     Triangle B(a, current_triangle[1], c);
     Triangle C(b, c, current_triangle[2]);
@@ -7,7 +7,6 @@
 #include <utility>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include <cassert>
 
 #include "FE_VEC.h"
@@ -124,10 +123,28 @@ private:
   std::vector<Coord> coords_;
 
   /// Information about the refinement to the next finer level
-  /// The first int (key) denotes a unique(!) ID for each edge in the GRID
-  /// The second int (value) denotes the number of the newly created
-  /// node in the specific edge wrt. to the node numbering in the finer GRID
-  std::unordered_map<int, int> refinement_info_;
+  /// refinement_info_[e] denotes the number of the newly created node
+  /// in edge e (see edge table below) wrt. to the node numbering in
+  /// the finer GRID
+  std::vector<int> refinement_info_;
+
+  /// Edge table in compressed row storage (CSR) format
+  /// Every edge (v, w) with v < w is stored in row v, i.e. the edges
+  /// starting in node v have the end nodes
+  /// edge_target_[edge_ptr_[v]], ..., edge_target_[edge_ptr_[v+1]-1]
+  /// and the (dense) edge numbers edge_index_[edge_ptr_[v]], ...
+  std::vector<int> edge_ptr_;
+  std::vector<int> edge_target_;
+  std::vector<int> edge_index_;
+
+  /// Edge number of each side of each triangle
+  /// Side s of triangle t connects the vertices t[s] and t[(s+1)%3] and
+  /// has the edge number tri_edges_[3*t+s]
+  std::vector<int> tri_edges_;
+
+  /// Nodes defining the edges
+  /// Edge e connects the nodes edge_nodes_[2*e] and edge_nodes_[2*e+1]
+  std::vector<int> edge_nodes_;
 
 public:
   /// Default constructor
@@ -199,20 +216,36 @@ public:
     coords_.push_back(new_vertex);
   }
 
-  int edge_id(int v_start_id, int v_end_id)
+  /// Get total number of edges in Grid
+  /// Only valid after compute_edge_table() has been called
+  int num_edges() const
   {
-    //x * y + trunc((|x - y| - 1)^2 / 4)
-    // https://gist.github.com/ma11hew28/9457506
-    v_start_id++;
-    v_end_id++;
-    if (v_start_id < v_end_id)
+    return edge_nodes_.size() / 2;
+  }
+
+  /// Compute edge table, i.e. edge_ptr_, edge_target_, edge_index_,
+  /// tri_edges_ and edge_nodes_
+  /// The edges are numbered in the order in which they are first met
+  /// in a loop over all triangles and their sides
+  void compute_edge_table();
+
+  /// Get number of the edge connecting the nodes a and b
+  /// Returns -1 if there is no such edge. Needs the edge table, see
+  /// compute_edge_table()
+  int find_edge(int a, int b) const
+  {
+    if (a > b)
     {
-      return v_start_id * v_end_id + pow(v_end_id - v_start_id - 1, 2) / 4;
+      std::swap(a, b);
     }
-    else
+    for (int k = edge_ptr_[a]; k < edge_ptr_[a + 1]; ++k)
     {
-      return v_start_id * v_end_id + pow(v_start_id - v_end_id - 1, 2) / 4;
+      if (edge_target_[k] == b)
+      {
+        return edge_index_[k];
+      }
     }
+    return -1;
   }
 
   /// Read grid from given files
@@ -0,0 +1,145 @@
+#ifndef _FE_MULTIVEC_H_
+#define _FE_MULTIVEC_H_
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <assert.h>
+
+#include "index.h"
+#include "aligned_allocator.h"
+#include "FE_VEC.h"
+
+/// @brief Container for several fields of point data on a GRID.
+/// The values are stored node by node, i.e. all fields of one node are
+/// contiguous in memory. Operations which touch all fields of a node
+/// (e.g. interpolation in GRID::refine_ip) thus read the data of each node
+/// contiguously instead of from num_fields separate arrays.
+class FE_MULTIVEC
+{
+private:
+	/// Values of all fields; field f of node i is values_[i*num_fields_+f]
+	std::vector<double, AlignedAllocator<double> > values_;
+
+	/// Number of fields
+	int num_fields_;
+
+	/// Names of the fields, see FE_VEC
+	std::vector<std::string> names_;
+
+public:
+
+	/// Construct FE_MULTIVEC with num_fields fields on size nodes.
+	/// Values are initialized to zero.
+	FE_MULTIVEC(int num_fields = 0, index_t size = 0)
+		: values_(), num_fields_(0), names_()
+	{
+		resize(size, num_fields);
+	}
+
+	/// Get number of nodes
+	inline index_t length( void ) const
+	{
+		return num_fields_ > 0 ? static_cast<index_t>(values_.size() / num_fields_) : 0;
+	}
+
+	/// Get number of fields
+	inline int num_fields( void ) const
+	{
+		return num_fields_;
+	}
+
+	/// Resize to newSize nodes and num_fields fields. Existing values are
+	/// kept if the number of fields does not change; new entries are
+	/// initialized with 0.
+	inline void resize(index_t newSize, int num_fields)
+	{
+		if(num_fields != num_fields_) {
+			values_.clear();
+			num_fields_ = num_fields;
+			names_.resize(num_fields, "Vector");
+		}
+		values_.resize(static_cast<count_t>(newSize) * num_fields, 0.0);
+	}
+
+	/// Set name of field f
+	inline void setName(int f, const char *Name)
+	{
+		assert(f >= 0 && f < num_fields_);
+		names_[f] = Name;
+	}
+
+	/// Get name of field f
+	inline const char* getName(int f) const
+	{
+		assert(f >= 0 && f < num_fields_);
+		return names_[f].c_str();
+	}
+
+	/// Access field f of node index
+	inline double& operator()(index_t index, int f)
+	{
+		assert(index >= 0 && index < length());
+		assert(f >= 0 && f < num_fields_);
+		return values_[static_cast<count_t>(index) * num_fields_ + f];
+	}
+
+	/// Access field f of node index
+	inline const double& operator()(index_t index, int f) const
+	{
+		assert(index >= 0 && index < length());
+		assert(f >= 0 && f < num_fields_);
+		return values_[static_cast<count_t>(index) * num_fields_ + f];
+	}
+
+	/// Get pointer to the num_fields() values of node index
+	inline double* node(index_t index)
+	{
+		return values_.data() + static_cast<count_t>(index) * num_fields_;
+	}
+
+	/// Get pointer to the num_fields() values of node index
+	inline const double* node(index_t index) const
+	{
+		return values_.data() + static_cast<count_t>(index) * num_fields_;
+	}
+
+	/// Get pointer to all values
+	inline double* data( void )
+	{
+		return values_.data();
+	}
+
+	/// Get pointer to all values
+	inline const double* data( void ) const
+	{
+		return values_.data();
+	}
+
+	/// Set fields from num_vec FE_VECs of equal length
+	inline void CopyFrom(const FE_VEC vecs[], int num_vec)
+	{
+		resize(num_vec > 0 ? vecs[0].length() : 0, num_vec);
+		for(int f = 0; f < num_vec; ++f) {
+			assert(vecs[f].length() == length());
+			names_[f] = vecs[f].getName();
+			for(index_t i = 0; i < length(); ++i) {
+				(*this)(i, f) = vecs[f][i];
+			}
+		}
+	}
+
+	/// Copy fields to num_fields() FE_VECs, e.g. for visualization
+	inline void CopyTo(FE_VEC vecs[]) const
+	{
+		for(int f = 0; f < num_fields_; ++f) {
+			vecs[f].resize(length());
+			vecs[f].setName(names_[f].c_str());
+			for(index_t i = 0; i < length(); ++i) {
+				vecs[f][i] = (*this)(i, f);
+			}
+		}
+	}
+};
+
+#endif
@@ -5,10 +5,12 @@
 
 #include <stdio.h>
 #include <vector>
+#include <string>
 #include <stdlib.h>
 #include <iostream>
 #include <assert.h>
 
+#include "index.h"
 #include "grid.h"
 
 /// @brief Vector class for point data on a GRID.
@@ -20,8 +22,8 @@ private:
 	
 	/// Name of the vector. Is written to visualization output such that
 	/// the data of this vector are accessible by this name in visualization
-	/// tools (e.g. ParaView)
-	char *name_;
+	/// tools (e.g. ParaView). The vector keeps its own copy of the name.
+	std::string name_;
 
 public:
 
@@ -29,20 +31,20 @@ public:
 	FE_VEC(void)
 	{
 		/// Set default name to "Vector"
-		name_ = (char*) "Vector";
+		name_ = "Vector";
 		values_.clear();
 	}
 
 	/// Construct vector with a given size. Values are initialized to zero.
-	FE_VEC(int size)
+	FE_VEC(index_t size)
 	{
-		name_ = (char*) "Vector";
+		name_ = "Vector";
 		values_.clear();
 		values_.resize(size, 0.0);
 	}
 
 	/// Construct vector as copy of vec
-	FE_VEC(FE_VEC& vec)
+	FE_VEC(const FE_VEC& vec)
 	{
 		this->name_ = vec.getName();
 		this->values_ = vec.getValues();
@@ -56,15 +58,15 @@ public:
 	}
 
 	/// Set name of vector
-	inline void setName( char *Name )
+	inline void setName( const char *Name )
 	{
 		name_ = Name;
 	}
 
 	/// Get name of Vector
-	inline char* getName( void ) const
+	inline const char* getName( void ) const
 	{
-		return name_;
+		return name_.c_str();
 	}
 
 	/// Get std::vector with values of this vector
@@ -73,16 +75,22 @@ public:
 		return values_;
 	}
 
+	/// Get std::vector with values of this vector
+	inline const std::vector<double>& getValues( void ) const
+	{
+		return values_;
+	}
+
 	/// Get length of this vector, i.e. number of elements in values_
-	inline int length( void ) const
+	inline index_t length( void ) const
 	{
-		return static_cast<int>(values_.size());
+		return static_cast<index_t>(values_.size());
 	}
 
 	/// Resize vector. If newSize is smaller than the current size, the last
 	/// elements will be deleted to fit the new size. If newSize is greater
 	/// than the current size, new entries will be initialized with 0.
-	inline void resize(int newSize)
+	inline void resize(index_t newSize)
 	{
 		values_.resize(newSize, 0.0);
 	}
@@ -91,33 +99,33 @@ public:
 	/// @param values new values to be set
 	/// @param indices indices of new values
 	template<class T>
-	inline void setValues(std::vector<T>& values, std::vector<int>& indices)
+	inline void setValues(std::vector<T>& values, std::vector<index_t>& indices)
 	{
 		assert(values.size() == indices.size());
 		assert(indices.size() <= values_.size());
 		
 		// set values
-		for(int i = 0; i < static_cast<int>(indices.size()); ++i) {
+		for(std::size_t i = 0; i < indices.size(); ++i) {
 			assert(indices[i] >= 0);
-			assert(indices[i] < static_cast<int>(values_.size()));
+			assert(indices[i] < static_cast<index_t>(values_.size()));
 			
 			values_[indices[i]] = static_cast<double>(values[i]);
 		}
 	}
 
 	/// Access component index
-	inline double& operator[](int index)
+	inline double& operator[](index_t index)
 	{
 		assert(index >= 0);
-		assert(index < static_cast<int>(values_.size()));
+		assert(index < static_cast<index_t>(values_.size()));
 		return values_[index];
 	}
 
 	/// Access component index
-	inline const double& operator[](int index) const
+	inline const double& operator[](index_t index) const
 	{
 		assert(index >= 0);
-		assert(index < static_cast<int>(values_.size()));
+		assert(index < static_cast<index_t>(values_.size()));
 		return values_[index];
 	}
 	
@@ -126,7 +134,7 @@ public:
 	inline void Axpy(const FE_VEC &x, const double fac) {
 		assert(x.length() == this->length());
 		
-		for(int i = 0; i < this->length(); ++i) {
+		for(index_t i = 0; i < this->length(); ++i) {
 			values_[i] += fac * x[i];
 		}
 	}
@@ -136,7 +144,7 @@ public:
 	inline void CopyFrom(const FE_VEC &x) {
 		assert(x.length() == this->length());
 		
-		for(int i = 0; i < this->length(); ++i) {
+		for(index_t i = 0; i < this->length(); ++i) {
 			values_[i] = x[i];
 		}
 	}
@@ -144,16 +152,27 @@ public:
 	/// NEW IN THIS EXERCISE
 	/// this = abs(this) per component
 	inline void Abs() {		
-		for(int i = 0; i < this->length(); ++i) {
+		for(index_t i = 0; i < this->length(); ++i) {
 			values_[i] = std::abs(values_[i]);
 		}
 	}
 
+	/// Renumber the components, e.g. after GRID::renumber_hilbert
+	/// Component i is moved to position perm[i]
+	inline void permute(const std::vector<index_t>& perm) {
+		assert(static_cast<index_t>(perm.size()) == this->length());
+
+		std::vector<double> old_values(values_);
+		for(index_t i = 0; i < this->length(); ++i) {
+			values_[perm[i]] = old_values[i];
+		}
+	}
+
 	/// Print out vector component by component
 	inline void print( void ) const
 	{
 		std::cout << name_ << ":" << std::endl;
-		for(int i = 0; i < static_cast<int>(values_.size()); ++i) {
+		for(index_t i = 0; i < static_cast<index_t>(values_.size()); ++i) {
 			std::cout << "\t" << i << ": " << values_[i] << std::endl;
 		}
 	}
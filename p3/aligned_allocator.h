@@ -0,0 +1,51 @@
+#ifndef _ALIGNED_ALLOCATOR_H_
+#define _ALIGNED_ALLOCATOR_H_
+
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+
+/// Alignment (in bytes) of arrays used in vectorized loops, e.g. the
+/// coordinate arrays of GRID. 64 bytes is the size of a cache line and of
+/// an AVX-512 register.
+const std::size_t SIMD_ALIGNMENT = 64;
+
+/// @brief Allocator for std::vector which aligns the memory to Alignment bytes
+template<class T, std::size_t Alignment = SIMD_ALIGNMENT>
+struct AlignedAllocator {
+	typedef T value_type;
+
+	template<class U>
+	struct rebind {
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+
+	template<class U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(std::size_t n) {
+		void *p = NULL;
+		if(posix_memalign(&p, Alignment, n * sizeof(T)) != 0) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, std::size_t) {
+		free(p);
+	}
+};
+
+template<class T, class U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+	return true;
+}
+
+template<class T, class U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+	return false;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "async_writer.h"
+
+AsyncWriter::AsyncWriter()
+	: stop_(false) {
+	thread_ = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+}
+
+void AsyncWriter::run() {
+	for(;;) {
+		std::unique_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+			if(queue_.empty()) {
+				return;
+			}
+			// the job stays in the queue until it is done, see wait()
+			job.swap(queue_.front());
+		}
+
+		int ret = job->pvd_->write(*job->grid_, job->vectors_.data(), static_cast<int>(job->vectors_.size()),
+		                           job->timestep_, job->time_, job->options_);
+		job->result_.set_value(ret);
+		// release the GRID before signaling, it may be the last handle
+		job.reset();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.pop_front();
+		}
+		cond_.notify_all();
+	}
+}
+
+std::future<int> AsyncWriter::write(
+	PvdCollection &pvd,
+	const std::shared_ptr<GRID> &g,
+	const FE_VEC u[],
+	int n_vectors,
+	int timestep,
+	double time,
+	const VtuOptions &options
+) {
+	std::unique_ptr<Job> job(new Job);
+	job->pvd_ = &pvd;
+	job->grid_ = g;
+	job->vectors_.assign(u, u + n_vectors);
+	job->timestep_ = timestep;
+	job->time_ = time;
+	job->options_ = options;
+	std::future<int> result = job->result_.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.push_back(std::move(job));
+	}
+	cond_.notify_all();
+	return result;
+}
+
+void AsyncWriter::wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	cond_.wait(lock, [this] { return queue_.empty(); });
+}
@@ -0,0 +1,84 @@
+#ifndef _ASYNC_WRITER_H_
+#define _ASYNC_WRITER_H_
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grid.h"
+#include "FE_VEC.h"
+#include "pvd_collection.h"
+
+/// @brief Queue for visualization output which is written by a background
+/// thread, such that e.g. the next level can be computed while the
+/// current one is written
+/// Jobs are processed in the order in which they have been submitted, so
+/// time steps of one pvd file arrive in the right order.
+class AsyncWriter {
+private:
+	/// Job for PvdCollection::write
+	struct Job {
+		/// Collection to which the time step is written
+		PvdCollection *pvd_;
+		/// GRID, kept alive until the job is done
+		std::shared_ptr<GRID> grid_;
+		/// Copies of the FE_VECs
+		std::vector<FE_VEC> vectors_;
+		int timestep_;
+		double time_;
+		VtuOptions options_;
+		/// Return value of PvdCollection::write
+		std::promise<int> result_;
+	};
+
+	/// Pending jobs
+	std::deque<std::unique_ptr<Job> > queue_;
+
+	std::mutex mutex_;
+
+	/// Signals new jobs and stop_ to the background thread
+	std::condition_variable cond_;
+
+	/// Set by the destructor, the background thread exits when the queue
+	/// is empty
+	bool stop_;
+
+	/// Background thread
+	std::thread thread_;
+
+	/// Main loop of the background thread
+	void run();
+
+public:
+	/// Constructor, starts the background thread
+	AsyncWriter();
+
+	/// Destructor, writes all pending jobs and stops the background thread
+	~AsyncWriter();
+
+	/// Submit pvd.write(*g, u, n_vectors, timestep, time, options)
+	/// The FE_VECs are copied, the GRID is shared. The coordinates and the
+	/// connectivity of g must not be changed until the job is done; other
+	/// operations on g, e.g. refinement, are fine. pvd must not be used
+	/// otherwise until the job is done.
+	/// @return future for the return value of PvdCollection::write
+	std::future<int> write(
+		PvdCollection &pvd,
+		const std::shared_ptr<GRID> &g,
+		const FE_VEC u[],
+		int n_vectors,
+		int timestep,
+		double time,
+		const VtuOptions &options = VtuOptions()
+	);
+
+	/// Wait until all submitted jobs are done
+	void wait();
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <utility>
+
+#include "grid.h"
+#include "FE_VEC.h"
+#include "grid_hierarchy.h"
+
+#include "exercise_sheet_3.h"
+
+/// Consistency checks of the refinement, the checkpoints, the streamed
+/// output and the Dirichlet boundary conditions, see make check
+
+static const char* coord_filename = "data/coords-square.dat";
+static const char* conn_filename = "data/conn-square.dat";
+static const char* bnd_filename = "data/bnd-square.dat";
+static const std::vector<int> dirichlet_tags = {2, 3};
+
+// Contents of a file as string
+static std::string file_contents(const char* filename) {
+	std::ifstream in(filename, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Bitwise comparison of the coordinates of node i of a and node j of b
+static bool same_node(const GRID &a, index_t i, const GRID &b, index_t j) {
+	for(int d = 0; d < NDIM; ++d) {
+		if(memcmp(a.coordinates(d) + i, b.coordinates(d) + j, sizeof(double)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Bitwise comparison of nodes and triangles of two GRIDs
+static bool same_grid(const GRID &a, const GRID &b) {
+	if(a.num_nodes() != b.num_nodes() || a.num_triangles() != b.num_triangles()) {
+		return false;
+	}
+	for(int d = 0; d < NDIM; ++d) {
+		if(memcmp(a.coordinates(d), b.coordinates(d), a.num_nodes() * sizeof(double)) != 0) {
+			return false;
+		}
+	}
+	return memcmp(a.triangles(), b.triangles(), a.num_triangles() * sizeof(Triangle)) == 0;
+}
+
+// Sides of the triangles of g which are not shared with a neighbour, i.e.
+// whose reverse is not a side of another triangle; false if a side occurs
+// twice in the same direction
+static bool open_sides(const GRID &g, std::vector<std::pair<index_t, index_t> > &sides) {
+	std::map<std::pair<index_t, index_t>, int> count;
+	for(index_t t = 0; t < g.num_triangles(); ++t) {
+		const Triangle &tri = g.triangles()[t];
+		for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+			if(++count[std::make_pair(tri[s], tri[(s+1) % NODES_PER_TRIANGLE])] > 1) {
+				return false;
+			}
+		}
+	}
+	sides.clear();
+	for(auto it = count.begin(); it != count.end(); ++it) {
+		if(count.find(std::make_pair(it->first.second, it->first.first)) == count.end()) {
+			sides.push_back(it->first);
+		}
+	}
+	return true;
+}
+
+// Newest vertex bisection: all triangles are counterclockwise and the
+// refined GRID is conforming, i.e. all sides without neighbour lie on the
+// boundary of the coarse GRID
+static bool check_nvb() {
+	GRID g[5];
+	g[0].read_from_file(coord_filename, conn_filename);
+	std::vector<std::pair<index_t, index_t> > coarse_sides, sides;
+	if(!open_sides(g[0], coarse_sides)) {
+		return false;
+	}
+	for(int k = 0; k < 4; ++k) {
+		std::vector<bool> marked(g[k].num_triangles(), false);
+		for(std::size_t t = k; t < marked.size(); t += 3) {
+			marked[t] = true;
+		}
+		g[k].refine_marked_ip(marked, NULL, 0, g[k+1], NULL);
+		const GRID &f = g[k+1];
+		if(f.num_triangles() <= g[k].num_triangles() || !open_sides(f, sides)) {
+			return false;
+		}
+		const double *x = f.coordinates(0), *y = f.coordinates(1);
+		for(index_t t = 0; t < f.num_triangles(); ++t) {
+			const Triangle &tri = f.triangles()[t];
+			if((x[tri[1]] - x[tri[0]]) * (y[tri[2]] - y[tri[0]]) - (x[tri[2]] - x[tri[0]]) * (y[tri[1]] - y[tri[0]]) <= 0) {
+				return false;
+			}
+		}
+		// a hanging node gives open sides inside the domain
+		for(std::size_t i = 0; i < sides.size(); ++i) {
+			bool on_boundary = false;
+			for(std::size_t j = 0; j < coarse_sides.size() && !on_boundary; ++j) {
+				const Coord a = g[0].get_coordinates(coarse_sides[j].first);
+				const Coord b = g[0].get_coordinates(coarse_sides[j].second);
+				bool inside = true;
+				for(int n = 0; n < 2; ++n) {
+					const Coord p = f.get_coordinates(n == 0 ? sides[i].first : sides[i].second);
+					const double cross = (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+					const double dot = (b[0] - a[0]) * (p[0] - a[0]) + (b[1] - a[1]) * (p[1] - a[1]);
+					const double len2 = (b[0] - a[0]) * (b[0] - a[0]) + (b[1] - a[1]) * (b[1] - a[1]);
+					inside = inside && cross == 0 && dot >= 0 && dot <= len2;
+				}
+				on_boundary = inside;
+			}
+			if(!on_boundary) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Checkpoint write -> read gives the same hierarchy and FE_VECs, and
+// writing it again gives the same file
+static bool check_checkpoint() {
+	GridHierarchy h(5, 2);
+	h.read_from_file(coord_filename, conn_filename, bnd_filename);
+	h.level(4);
+	h.release(3);
+	std::vector<std::vector<FE_VEC> > vectors(5);
+	vectors[4].resize(1);
+	vectors[4][0].setName("Boundary flag");
+	h.level(4).boundary_flag_to_FE_VEC(vectors[4][0]);
+
+	GridHierarchy r(1);
+	std::vector<std::vector<FE_VEC> > read_vectors;
+	if(h.write_checkpoint("data/check_0.ckpt", vectors) != 0
+	   || r.read_checkpoint("data/check_0.ckpt", read_vectors) != 0
+	   || r.write_checkpoint("data/check_1.ckpt", read_vectors) != 0
+	   || r.num_levels() != h.num_levels() || read_vectors.size() != vectors.size()) {
+		return false;
+	}
+	for(int k = 0; k < h.num_levels(); ++k) {
+		if(r.is_resident(k) != h.is_resident(k) || read_vectors[k].size() != vectors[k].size()) {
+			return false;
+		}
+		if(h.is_resident(k) && !same_grid(h.level(k), r.level(k))) {
+			return false;
+		}
+		for(std::size_t i = 0; i < vectors[k].size(); ++i) {
+			if(strcmp(vectors[k][i].getName(), read_vectors[k][i].getName()) != 0
+			   || vectors[k][i].getValues() != read_vectors[k][i].getValues()) {
+				return false;
+			}
+		}
+	}
+	return file_contents("data/check_0.ckpt") == file_contents("data/check_1.ckpt");
+}
+
+// Streamed level k equals level(k): the file is the one GRID::write_binary
+// writes for the mesh read from it, the triangles are those of level(k)
+// with bitwise equal coordinates, and the boundary nodes are the same
+static bool check_stream() {
+	GridHierarchy h(6, 3);
+	h.read_from_file(coord_filename, conn_filename, bnd_filename);
+	for(int k = 0; k < h.num_levels(); ++k) {
+		if(h.write_binary(k, "data/check_0.bin", true, 1000) != 0) {
+			return false;
+		}
+		GRID r;
+		r.read_binary("data/check_0.bin");
+		r.write_binary("data/check_1.bin");
+		if(file_contents("data/check_0.bin") != file_contents("data/check_1.bin")) {
+			return false;
+		}
+
+		GRID &g = h.level(k);
+		if(r.num_nodes() != g.num_nodes() || r.num_triangles() != g.num_triangles()) {
+			return false;
+		}
+		FE_VEC flag, read_flag;
+		g.boundary_flag_to_FE_VEC(flag);
+		r.boundary_flag_to_FE_VEC(read_flag);
+		for(index_t t = 0; t < g.num_triangles(); ++t) {
+			for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+				const index_t i = g.triangles()[t][s], j = r.triangles()[t][s];
+				if(!same_node(g, i, r, j) || flag[i] != read_flag[j]) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// refine_dirichlet_bc gives the same Dirichlet nodes and values as
+// compute_dirichlet_bc on the finer GRID, for uniform and local refinement;
+// the values are evaluated in batches of different length, which may round
+// differently with -Ofast
+static bool check_dirichlet_bc() {
+	GRID g[6];
+	g[0].read_from_file(coord_filename, conn_filename);
+	g[0].read_boundary_tags(bnd_filename);
+	std::vector<index_t> nodes, computed_nodes;
+	std::vector<double> val, computed_val;
+	g[0].compute_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), nodes, val);
+	for(int k = 0; k < 5; ++k) {
+		if(k % 2 == 0) {
+			g[k].refine_ip(NULL, 0, g[k+1], NULL, 2);
+		} else {
+			std::vector<bool> marked(g[k].num_triangles(), false);
+			for(std::size_t t = 0; t < marked.size(); t += 3) {
+				marked[t] = true;
+			}
+			g[k].refine_marked_ip(marked, NULL, 0, g[k+1], NULL);
+		}
+		if(!g[k].refine_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), g[k+1], nodes, val)) {
+			return false;
+		}
+		g[k+1].compute_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), computed_nodes, computed_val);
+		if(nodes != computed_nodes || val.size() != computed_val.size()) {
+			return false;
+		}
+		for(std::size_t i = 0; i < val.size(); ++i) {
+			if(std::fabs(val[i] - computed_val[i]) > 1e-14) {
+				return false;
+			}
+		}
+	}
+
+	// a renumbered finer GRID is rejected
+	std::vector<index_t> node_perm, tri_perm;
+	g[0].refine_ip(NULL, 0, g[1], NULL);
+	g[1].renumber_hilbert(node_perm, tri_perm);
+	g[0].compute_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), nodes, val);
+	return !g[0].refine_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), g[1], nodes, val);
+}
+
+int main(int argc, char *argv[]) {
+
+	struct {
+		const char* name;
+		bool (*check)();
+	} checks[] = {
+		{"newest vertex bisection", check_nvb},
+		{"checkpoint", check_checkpoint},
+		{"streamed levels", check_stream},
+		{"Dirichlet boundary conditions", check_dirichlet_bc}
+	};
+
+	int failed = 0;
+	for(std::size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+		const bool ok = checks[i].check();
+		std::cout << checks[i].name << ": " << (ok ? "ok" : "FAILED") << std::endl;
+		failed += !ok;
+	}
+	return failed == 0 ? 0 : 1;
+}
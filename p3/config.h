@@ -16,5 +16,35 @@ const char* coord_filename = (char*) "data/coords-square.dat";
 /// Filename for connectivity information
 const char* conn_filename = (char*) "data/conn-square.dat";
 
+/// Filename for the tags of the boundary edges, see GRID::read_boundary_tags
+const char* bnd_filename = (char*) "data/bnd-square.dat";
+
+/// Tags of the boundary edges with Dirichlet boundary conditions
+/// (2: side x = 1, 3: side y = 1 of the unit square)
+const std::vector<int> dirichlet_tags = {2, 3};
+
 /// Total number of GRIDs including original mesh
 const int grids = 8;
+
+/// Number of threads used for the refinement of the GRIDs
+const int num_threads = 4;
+
+///===================================================================
+/// Configuration parameters for output
+///===================================================================
+
+/// Encoding of the vtu files, VTU_ASCII, VTU_APPENDED_RAW,
+/// VTU_APPENDED_ZLIB or VTU_APPENDED_LZ4 (needs -DHAVE_LZ4)
+const VtuFormat vtu_format = VTU_APPENDED_ZLIB;
+
+/// Type of coordinates and point data in the vtu files, VTU_FLOAT64 or
+/// VTU_FLOAT32 (half the size, sufficient for visualization)
+const VtuPrecision vtu_precision = VTU_FLOAT32;
+
+/// Absolute error allowed for the point data in the vtu files; if positive,
+/// the values are quantized to compress better. 0 writes the exact values.
+const double vtu_quantization_tolerance = 0.0;
+
+/// Number of pieces, i.e. files written concurrently, per level; levels
+/// are written as single vtu file if this is 1
+const int vtu_pieces = num_threads;
@@ -3,17 +3,24 @@
 #ifndef _EXERCISE_SHEET_2_H_
 #define _EXERCISE_SHEET_2_H_
 
-#include <cassert>
 #include <cmath>
 
-/// Function to compute exact function values for exercise sheet 2
-void compute_function_sheet_2(GRID &g, FE_VEC &vec) {
-    assert(g.num_nodes() == vec.length());
-    
-    for(int i = 0; i < g.num_nodes(); ++i) {
-        Coord pt_i = g.get_coordinates(i);
-        vec[i] = std::sin(M_PI * pt_i[0]) * std::exp(pt_i[1]);
+/// Exact function sin(pi * x) * exp(y) for exercise sheet 2, see
+/// GRID::evaluate
+struct FunctionSheet2 {
+    void operator()(count_t n, const double *const coords[NDIM], double *values) const {
+        const double *x = coords[0];
+        const double *y = coords[1];
+        for(count_t i = 0; i < n; ++i) {
+            values[i] = std::sin(M_PI * x[i]) * std::exp(y[i]);
+        }
     }
+};
+
+/// Function to compute exact function values for exercise sheet 2
+/// vec is resized to the number of nodes of g
+void compute_function_sheet_2(GRID &g, FE_VEC &vec, int num_threads = 1) {
+    g.evaluate(FunctionSheet2(), vec, num_threads);
 }
 
 #endif
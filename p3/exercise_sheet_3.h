@@ -6,17 +6,33 @@
 #include <cassert>
 #include <cmath>
 
-/// Function to compute Dirichlet boundary condition for practical exercise 3
-/// @param[in] g GRID on which Dirichlet BC is computed
-/// @param[in] pts indices of points on current boundary edge
-/// @param[out] dirichlet_val if empty, no Dirichlet BC at given points; otherwise, contains Dirichlet BC at given points (both!!)
-void Dirichlet_BC_exercise_3(GRID &g, const std::vector<int> &pts, std::vector<double> &dirichlet_val) {
-    dirichlet_val.clear();
-    if((g.get_coordinates(pts[0])[1] == 1.0 && g.get_coordinates(pts[1])[1] == 1.0) || (g.get_coordinates(pts[0])[0] == 1.0 && g.get_coordinates(pts[1])[0] == 1.0)) {
-        dirichlet_val.resize(2);
-        dirichlet_val[0] = std::cos(g.get_coordinates(pts[0])[0]) * std::cos(g.get_coordinates(pts[0])[1]);
-        dirichlet_val[1] = std::cos(g.get_coordinates(pts[1])[0]) * std::cos(g.get_coordinates(pts[1])[1]);
+/// Batched Dirichlet boundary condition for practical exercise 3, see
+/// GRID::compute_dirichlet_bc
+/// Nodes on the sides x = 1 and y = 1 of the unit square are Dirichlet
+/// nodes with the value cos(x) * cos(y).
+struct DirichletBCExercise3 {
+    void operator()(count_t n, const double *const coords[NDIM], double *values, unsigned char *is_dirichlet) const {
+        const double *x = coords[0];
+        const double *y = coords[1];
+        for(count_t i = 0; i < n; ++i) {
+            values[i] = std::cos(x[i]) * std::cos(y[i]);
+            is_dirichlet[i] = x[i] == 1.0 || y[i] == 1.0;
+        }
     }
-}
+};
+
+/// Boundary values for practical exercise 3, see the tag based
+/// GRID::compute_dirichlet_bc
+/// The Dirichlet boundary is selected by the tags of the boundary edges
+/// (see dirichlet_tags in config.h), the nodes get the value cos(x) * cos(y).
+struct DirichletValuesExercise3 {
+    void operator()(count_t n, const double *const coords[NDIM], double *values) const {
+        const double *x = coords[0];
+        const double *y = coords[1];
+        for(count_t i = 0; i < n; ++i) {
+            values[i] = std::cos(x[i]) * std::cos(y[i]);
+        }
+    }
+};
 
 #endif
@@ -2,94 +2,662 @@
 
 #include <fstream>
 #include <sstream>
-#include <map>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <limits>
 #include "grid.h"
+#include "FE_MULTIVEC.h"
+#include "parallel.h"
+
+// Memory mapped text file
+struct MappedFile {
+  const char *data;
+  size_t size;
+};
+
+// Map filename into memory; data is NULL for empty files
+static bool map_file(const char* filename, MappedFile &file) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  file.size = st.st_size;
+  file.data = NULL;
+  if (file.size > 0) {
+    void *map = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(map, file.size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    file.data = static_cast<const char*>(map);
+  }
+  close(fd);
+  return true;
+}
+
+static bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parse a number from [p, end) after skipping blanks; p is advanced
+// behind the number
+template<class T>
+static bool parse_number(const char *&p, const char *end, T &value) {
+  while (p < end && is_blank(*p)) {
+    ++p;
+  }
+  if (p < end && *p == '+') {
+    ++p;
+  }
+  std::from_chars_result r = std::from_chars(p, end, value);
+  if (r.ec != std::errc() || (r.ptr < end && !is_blank(*r.ptr))) {
+    return false;
+  }
+  p = r.ptr;
+  return true;
+}
+
+// Parse a text file with (at least) num_values numbers of type T on each
+// non-blank line, further numbers in a line are ignored. The file is
+// memory mapped and split into line-aligned chunks which are parsed by
+// num_threads threads.
+// resize(n) is called once with the number of non-blank lines, then
+// store(i, k, value) is called for number k on the i-th non-blank line.
+// Returns false and an error message in error if the file cannot be read
+// or a line is invalid.
+template<class T, class Resize, class Store>
+static bool parse_dat_file(const char* filename, int num_values, int num_threads,
+                           Resize resize, Store store, std::string &error) {
+  MappedFile file;
+  if (!map_file(filename, file)) {
+    error = std::string("Could not open ") + filename + " for reading.";
+    return false;
+  }
+  const char *data = file.data;
+  const char *end = data + file.size;
+
+  // chunk boundaries at line starts
+  const count_t size = file.size;
+  const int num_chunks_used = num_chunks(count_t(0), size, num_threads);
+  std::vector<const char*> chunk(num_chunks_used + 1);
+  chunk[0] = data;
+  for (int c = 1; c < num_chunks_used; ++c) {
+    const char *p = std::max(chunk[c-1], data + chunk_begin(count_t(0), size, num_chunks_used, c));
+    const char *nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    chunk[c] = nl ? nl + 1 : end;
+  }
+  chunk[num_chunks_used] = end;
+
+  // count non-blank lines per chunk
+  std::vector<count_t> first_entry(num_chunks_used + 1, 0);
+  std::vector<count_t> first_line(num_chunks_used + 1, 0);
+  parallel_for(0, num_chunks_used, num_chunks_used, [&](int c, int, int) {
+    count_t entries = 0, lines = 0;
+    for (const char *p = chunk[c]; p < chunk[c+1]; ) {
+      const char *nl = static_cast<const char*>(memchr(p, '\n', chunk[c+1] - p));
+      const char *line_end = nl ? nl : chunk[c+1];
+      while (p < line_end && is_blank(*p)) {
+        ++p;
+      }
+      entries += p < line_end;
+      ++lines;
+      p = line_end + 1;
+    }
+    first_entry[c+1] = entries;
+    first_line[c+1] = lines;
+  });
+  for (int c = 0; c < num_chunks_used; ++c) {
+    first_entry[c+1] += first_entry[c];
+    first_line[c+1] += first_line[c];
+  }
+
+  resize(first_entry[num_chunks_used]);
+
+  // parse; bad_line[c] is the (1-based) number of the first invalid line
+  // in chunk c or 0
+  std::vector<count_t> bad_line(num_chunks_used, 0);
+  parallel_for(0, num_chunks_used, num_chunks_used, [&](int c, int, int) {
+    count_t entry = first_entry[c], line = first_line[c];
+    for (const char *p = chunk[c]; p < chunk[c+1]; ) {
+      const char *nl = static_cast<const char*>(memchr(p, '\n', chunk[c+1] - p));
+      const char *line_end = nl ? nl : chunk[c+1];
+      ++line;
+      const char *q = p;
+      while (q < line_end && is_blank(*q)) {
+        ++q;
+      }
+      if (q < line_end) {
+        for (int k = 0; k < num_values; ++k) {
+          T value;
+          if (!parse_number(q, line_end, value)) {
+            bad_line[c] = line;
+            return;
+          }
+          store(entry, k, value);
+        }
+        ++entry;
+      }
+      p = line_end + 1;
+    }
+  });
+
+  if (file.data != NULL) {
+    munmap(const_cast<char*>(file.data), file.size);
+  }
+
+  for (int c = 0; c < num_chunks_used; ++c) {
+    if (bad_line[c] > 0) {
+      std::ostringstream msg;
+      msg << "Line " << bad_line[c] << " of " << filename << " does not contain " << num_values << " valid numbers.";
+      error = msg.str();
+      return false;
+    }
+  }
+  return true;
+}
 
 void GRID::read_from_file(
   const char* coords_filename,
-  const char* conn_filename
+  const char* conn_filename,
+  int num_threads
 ) {
+  std::string error;
 
-  // ifstream to read coordinate data, automatically opens coords_filename
-  std::ifstream coords(coords_filename);
-
-  // ifstream to read coordinate data, automatically opens coords_filename
-  std::ifstream conns(conn_filename);
+  // read point coordinates, one node per line
+  if (!parse_dat_file<double>(coords_filename, NDIM, num_threads,
+        [&](count_t n) {
+          for (int d = 0; d < NDIM; ++d) {
+            coords_[d].assign(n, 0.0);
+          }
+        },
+        [&](count_t i, int d, double value) {
+          coords_[d][i] = value;
+        }, error)) {
+    std::cout << error << std::endl;
+    exit(-1);
+  }
+  if (num_nodes() != static_cast<count_t>(coords_[0].size())) {
+    std::cout << coords_filename << " contains too many nodes for index_t." << std::endl;
+    exit(-1);
+  }
 
-  // check if coords_filename exists and read in data
-  if (!coords.is_open()) {
-    std::cout << "Could not open " << coords_filename << " for reading coordinates." << std::endl;
+  // read connectivity, one triangle per line with 1-based node numbers
+  if (!parse_dat_file<count_t>(conn_filename, NODES_PER_TRIANGLE, num_threads,
+        [&](count_t n) {
+          conn_.resize(n);
+        },
+        [&](count_t i, int j, count_t value) {
+          // out of range numbers are caught below
+          conn_[i][j] = (value >= 1 && value <= num_nodes()) ? static_cast<index_t>(value - 1) : -1;
+        }, error)) {
+    std::cout << error << std::endl;
+    exit(-1);
+  }
+  if (num_triangles() != static_cast<count_t>(conn_.size())) {
+    std::cout << conn_filename << " contains too many triangles for index_t." << std::endl;
     exit(-1);
-  } else {
-    // read point coordinates
-    while (!coords.eof()) {
-      Coord temp;
-      std::string str;
-      std::getline(coords, str);
-      std::stringstream ss(str);
-      int component = 0;
-      while(component < NDIM && ss >> temp[component]) {
-        ++component;
+  }
+  for (index_t i = 0; i < num_triangles(); ++i) {
+    for (int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+      if (conn_[i][j] < 0) {
+        std::cout << "Triangle " << i + 1 << " in " << conn_filename << " has an invalid node number." << std::endl;
+        exit(-1);
       }
-      this->add_vertex(temp);
     }
-    coords_.pop_back();
-    coords.close();
   }
 
-  // check if conn_filename exists and read in data
-  if (!conns.is_open()) {
-    std::cout << "Could not open " << conn_filename << " for reading connectivity." << std::endl;
+  // drop data of a previously stored GRID
+  clear_edge_table();
+  renumbered_ = false;
+  init(num_threads);
+}
+
+void GRID::read_boundary_tags(const char* filename) {
+  std::string error;
+
+  // one segment per line: two 1-based node numbers and the tag
+  std::vector<count_t> segments;
+  if (!parse_dat_file<count_t>(filename, 3, 1,
+        [&](count_t n) {
+          segments.assign(3 * n, 0);
+        },
+        [&](count_t i, int j, count_t value) {
+          segments[3 * i + j] = value;
+        }, error)) {
+    std::cout << error << std::endl;
     exit(-1);
-  } else {
-    // read point coordinates
-    while (!conns.eof()) {
-      Triangle temp;
-      std::string str;
-      std::getline(conns, str);
-      std::stringstream ss(str);
-      int component = 0;
-      while(component < NODES_PER_TRIANGLE && ss >> temp[component]) {
-        temp[component] -= 1;
-        ++component;
+  }
+
+  if (!check_boundary_edges()) {
+    std::cout << "The boundary edges of the GRID are no edges of its triangles." << std::endl;
+    exit(-1);
+  }
+
+  // position of each edge of the GRID in boundary_edges_, -1 for interior
+  // edges
+  std::vector<index_t> boundary_pos(num_edges(), -1);
+  for (std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+    boundary_pos[find_edge(boundary_edges_[i].nodes_[0], boundary_edges_[i].nodes_[1])] = i;
+  }
+
+  for (std::size_t i = 0; 3 * i < segments.size(); ++i) {
+    const count_t a = segments[3 * i] - 1;
+    const count_t b = segments[3 * i + 1] - 1;
+    const count_t tag = segments[3 * i + 2];
+    const index_t e = (a >= 0 && a < num_nodes() && b >= 0 && b < num_nodes())
+      ? find_edge(static_cast<index_t>(a), static_cast<index_t>(b)) : -1;
+    if (e < 0 || boundary_pos[e] < 0) {
+      std::cout << "Segment " << i + 1 << " in " << filename << " is no boundary edge of the GRID." << std::endl;
+      exit(-1);
+    }
+    if (tag < 0 || tag > std::numeric_limits<int>::max()) {
+      std::cout << "Segment " << i + 1 << " in " << filename << " has an invalid tag." << std::endl;
+      exit(-1);
+    }
+    boundary_edges_[boundary_pos[e]].tag_ = static_cast<int>(tag);
+  }
+
+  compute_boundary_flag();
+}
+
+
+void GRID::compute_edge_table(int num_threads) {
+
+  if(num_threads > 1) {
+    compute_edge_table_parallel(num_threads);
+    return;
+  }
+
+  const index_t nn = this->num_nodes();
+  const index_t nt = this->num_triangles();
+
+  // Every side of a triangle is stored in the row of its smaller node.
+  // Count the sides per row to get an upper bound for the row lengths
+  // (interior edges are counted twice).
+  std::vector<count_t> row_start(nn + 1, 0);
+  for(index_t i = 0; i < nt; ++i) {
+    const Triangle &t = conn_[i];
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      ++row_start[std::min(t[s], t[(s+1) % NODES_PER_TRIANGLE]) + 1];
+    }
+  }
+  for(index_t v = 0; v < nn; ++v) {
+    row_start[v+1] += row_start[v];
+  }
+
+  // preliminary rows, filled up to row_len[v]
+  std::vector<index_t> row_len(nn, 0);
+  std::vector<index_t> target(row_start[nn]);
+  std::vector<index_t> index(row_start[nn]);
+
+  tri_edges_.resize(static_cast<count_t>(NODES_PER_TRIANGLE) * nt);
+  edge_nodes_.clear();
+  edge_nodes_.reserve(2 * (static_cast<count_t>(nn) + nt));
+
+  // loop over all triangles and their sides; an edge gets a new number
+  // when it is met for the first time
+  index_t ne = 0;
+  for(index_t i = 0; i < nt; ++i) {
+    const Triangle &t = conn_[i];
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      const index_t a = t[s];
+      const index_t b = t[(s+1) % NODES_PER_TRIANGLE];
+      const index_t lo = std::min(a, b);
+      const index_t hi = std::max(a, b);
+
+      // search edge in row of lo
+      const count_t begin = row_start[lo];
+      const count_t end = begin + row_len[lo];
+      index_t e = -1;
+      for(count_t k = begin; k < end; ++k) {
+        if(target[k] == hi) {
+          e = index[k];
+          break;
+        }
+      }
+
+      if(e < 0) { // edge is met for the first time
+        e = ne++;
+        target[end] = hi;
+        index[end] = e;
+        ++row_len[lo];
+        edge_nodes_.push_back(a);
+        edge_nodes_.push_back(b);
       }
-      this->add_triangle(temp);
+      tri_edges_[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s] = e;
     }
-    conn_.pop_back();
-    conns.close();
   }
 
-  init();
+  // compress rows
+  edge_ptr_.resize(nn + 1);
+  index_t pos = 0;
+  for(index_t v = 0; v < nn; ++v) {
+    edge_ptr_[v] = pos;
+    for(count_t k = row_start[v]; k < row_start[v] + row_len[v]; ++k, ++pos) {
+      target[pos] = target[k];
+      index[pos] = index[k];
+    }
+  }
+  edge_ptr_[nn] = pos;
+  target.resize(ne);
+  index.resize(ne);
+  edge_target_.swap(target);
+  edge_index_.swap(index);
+  edge_nodes_.shrink_to_fit();
 }
 
 
-void GRID::refine_ip(
-  const FE_VEC in[],
-  int num_vec,
-  GRID &newgrid,
-  FE_VEC out[]
-) {
+/// Check if triangle t contains node v
+static inline bool contains_node(const Triangle &t, index_t v) {
+  return t[0] == v || t[1] == v || t[2] == v;
+}
+
+void GRID::compute_edge_table_parallel(int num_threads) {
+
+  const index_t nn = this->num_nodes();
+  const index_t nt = this->num_triangles();
+
+  // counters / insertion positions per node
+  std::unique_ptr<std::atomic<count_t>[]> pos(new std::atomic<count_t>[nn + 1]);
+  parallel_for(index_t(0), nn + 1, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t v = begin; v < end; ++v) {
+      pos[v].store(0, std::memory_order_relaxed);
+    }
+  });
+
+  // node-to-triangle table in CSR format, i.e. node v is contained in the
+  // triangles node_tri[node_tri_ptr[v]], ..., node_tri[node_tri_ptr[v+1]-1]
+  // (in arbitrary order)
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t i = begin; i < end; ++i) {
+      for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+        pos[conn_[i][s] + 1].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  });
+  std::vector<count_t> node_tri_ptr(nn + 1, 0);
+  for(index_t v = 0; v < nn; ++v) {
+    node_tri_ptr[v+1] = node_tri_ptr[v] + pos[v+1].load(std::memory_order_relaxed);
+    pos[v].store(node_tri_ptr[v], std::memory_order_relaxed);
+  }
+  std::vector<index_t> node_tri(node_tri_ptr[nn]);
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t i = begin; i < end; ++i) {
+      for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+        node_tri[pos[conn_[i][s]].fetch_add(1, std::memory_order_relaxed)] = i;
+      }
+    }
+  });
+
+  // first pass: determine the owner of each triangle side, i.e. the
+  // triangle with the smallest number containing the same edge, and count
+  // the edges owned by each chunk of triangles
+  std::vector<index_t> owner(static_cast<count_t>(NODES_PER_TRIANGLE) * nt);
+  std::vector<index_t> chunk_start(num_chunks(index_t(0), nt, num_threads) + 1, 0);
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int c) {
+    index_t num_owned = 0;
+    for(index_t i = begin; i < end; ++i) {
+      for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+        const index_t a = conn_[i][s];
+        const index_t b = conn_[i][(s+1) % NODES_PER_TRIANGLE];
+        index_t o = i;
+        for(count_t k = node_tri_ptr[a]; k < node_tri_ptr[a+1]; ++k) {
+          const index_t j = node_tri[k];
+          if(j < o && contains_node(conn_[j], b)) {
+            o = j;
+          }
+        }
+        owner[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s] = o;
+        if(o == i) {
+          ++num_owned;
+        }
+      }
+    }
+    chunk_start[c+1] = num_owned;
+  });
+
+  // prefix sum gives the number of the first edge owned by each chunk
+  for(int c = 1; c < static_cast<int>(chunk_start.size()); ++c) {
+    chunk_start[c] += chunk_start[c-1];
+  }
+  const index_t ne = chunk_start.back();
+
+  // second pass: number owned edges in the order of the triangle loop
+  tri_edges_.resize(static_cast<count_t>(NODES_PER_TRIANGLE) * nt);
+  edge_nodes_.resize(2 * static_cast<count_t>(ne));
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int c) {
+    index_t e = chunk_start[c];
+    for(index_t i = begin; i < end; ++i) {
+      for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+        if(owner[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s] == i) {
+          tri_edges_[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s] = e;
+          edge_nodes_[2*static_cast<count_t>(e)] = conn_[i][s];
+          edge_nodes_[2*static_cast<count_t>(e)+1] = conn_[i][(s+1) % NODES_PER_TRIANGLE];
+          ++e;
+        }
+      }
+    }
+  });
+
+  // third pass: take over edge numbers of sides which are not owned
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t i = begin; i < end; ++i) {
+      for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+        const index_t o = owner[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s];
+        if(o == i) {
+          continue;
+        }
+        const index_t a = conn_[i][s];
+        const index_t b = conn_[i][(s+1) % NODES_PER_TRIANGLE];
+        for(int r = 0; r < NODES_PER_TRIANGLE; ++r) {
+          const index_t c = conn_[o][r];
+          const index_t d = conn_[o][(r+1) % NODES_PER_TRIANGLE];
+          if((c == a && d == b) || (c == b && d == a)) {
+            tri_edges_[static_cast<count_t>(NODES_PER_TRIANGLE) * i + s] = tri_edges_[static_cast<count_t>(NODES_PER_TRIANGLE) * o + r];
+            break;
+          }
+        }
+      }
+    }
+  });
+
+  // vertex-to-edge table; rows are sorted by edge number as in the
+  // serial version
+  parallel_for(index_t(0), nn + 1, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t v = begin; v < end; ++v) {
+      pos[v].store(0, std::memory_order_relaxed);
+    }
+  });
+  parallel_for(index_t(0), ne, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t e = begin; e < end; ++e) {
+      pos[std::min(edge_node(e, 0), edge_node(e, 1)) + 1].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  edge_ptr_.assign(nn + 1, 0);
+  for(index_t v = 0; v < nn; ++v) {
+    edge_ptr_[v+1] = edge_ptr_[v] + pos[v+1].load(std::memory_order_relaxed);
+    pos[v].store(edge_ptr_[v], std::memory_order_relaxed);
+  }
+  edge_target_.resize(ne);
+  edge_index_.resize(ne);
+  parallel_for(index_t(0), ne, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t e = begin; e < end; ++e) {
+      const index_t a = edge_node(e, 0);
+      const index_t b = edge_node(e, 1);
+      const count_t k = pos[std::min(a, b)].fetch_add(1, std::memory_order_relaxed);
+      edge_target_[k] = std::max(a, b);
+      edge_index_[k] = e;
+    }
+  });
+  parallel_for(index_t(0), nn, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t v = begin; v < end; ++v) {
+      // insertion sort, rows are short
+      for(index_t k = edge_ptr_[v] + 1; k < edge_ptr_[v+1]; ++k) {
+        const index_t target = edge_target_[k];
+        const index_t index = edge_index_[k];
+        index_t l = k;
+        for(; l > edge_ptr_[v] && edge_index_[l-1] > index; --l) {
+          edge_target_[l] = edge_target_[l-1];
+          edge_index_[l] = edge_index_[l-1];
+        }
+        edge_target_[l] = target;
+        edge_index_[l] = index;
+      }
+    }
+  });
+}
+
+
+void GRID::clear_edge_table() {
+  edge_ptr_.clear();
+  edge_target_.clear();
+  edge_index_.clear();
+  tri_edges_.clear();
+  edge_nodes_.clear();
+  refinement_info_.clear();
+}
+
 
-  // node numbers in old grid on each triangle
-  int  o1, o2, o3;
+bool GRID::refine_grid(GRID &newgrid, int num_threads) {
 
-  // IDs of edges in old grid on each triangle
-  int entry1, entry2, entry3;
+  // newgrid gets new triangles, i.e. tables of a GRID previously stored
+  // in it are not valid anymore
+  newgrid.clear_edge_table();
+  newgrid.renumbered_ = false;
 
-  // Iterators in refinement_info_ for each edge.
-  // Points to the corresponding entry for edge{1, 2, 3} in refinement info
-  // if edge has already been refined; otherwise, it points to the end of
-  // refinement_info_
-  std::unordered_map<int, int>::iterator k1, k2, k3;
+  // (re)build edge table if necessary
+  if(static_cast<count_t>(tri_edges_.size()) != static_cast<count_t>(NODES_PER_TRIANGLE) * this->num_triangles()) {
+    compute_edge_table(num_threads);
+  }
+  if(!check_boundary_edges()) {
+    std::cout << "The boundary edges of the GRID are no edges of its triangles." << std::endl;
+    return false;
+  }
+
+  const index_t nn = this->num_nodes();
+  const index_t ne = this->num_edges();
+  const index_t nt = this->num_triangles();
+
+  // check that the numbers of nodes and triangles in newgrid can be
+  // represented by index_t
+  if(static_cast<count_t>(nn) + ne > std::numeric_limits<index_t>::max() || 4 * static_cast<count_t>(nt) > std::numeric_limits<index_t>::max()) {
+    std::cout << "Refined grid (" << static_cast<count_t>(nn) + ne << " nodes, " << 4 * static_cast<count_t>(nt) << " triangles) exceeds the range of index_t. Compile with -DGRID_LARGE_INDEX." << std::endl;
+    return false;
+  }
+
+  // The new node in edge e gets the number nn + e in newgrid. As the edges
+  // are numbered in the order of their first appearance in the triangle
+  // loop, this is the same numbering as creating the new nodes on the fly.
+  refinement_info_.resize(ne);
+
+  // newgrid contains all old nodes, one new node per edge and 4 times the
+  // number of triangles of old grid
+  for(int d = 0; d < NDIM; ++d) {
+    newgrid.coords_[d].resize(nn + ne);
+  }
+  newgrid.conn_.resize(4 * nt);
+
+  // copy already existing nodes
+  parallel_for(index_t(0), nn, num_threads, [&](index_t begin, index_t end, int) {
+    for(int d = 0; d < NDIM; ++d) {
+      std::copy(coords_[d].begin() + begin, coords_[d].begin() + end, newgrid.coords_[d].begin() + begin);
+    }
+  });
+
+  // create new nodes in the middle of each edge
+  parallel_for(index_t(0), ne, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t e = begin; e < end; ++e) {
+      refinement_info_[e] = nn + e;
+    }
+    for(int d = 0; d < NDIM; ++d) {
+      const double *x = coords_[d].data();
+      double *new_x = newgrid.coords_[d].data() + nn;
+      for(index_t e = begin; e < end; ++e) {
+        new_x[e] = (x[edge_node(e, 0)] + x[edge_node(e, 1)]) * 0.5;
+      }
+    }
+  });
+
+  // loop over all triangles and create the new triangles
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t i = begin; i < end; i++){
+
+      //get nodes in triangle i of old grid
+      const index_t o1 = conn_[i][0];
+      const index_t o2 = conn_[i][1];
+      const index_t o3 = conn_[i][2];
 
-  // node numbers of newly added nodes on each triangle (wrt. old grid)
-  int node1, node2, node3;
+      // numbers of new nodes in the edges of triangle i
+      const count_t side = static_cast<count_t>(NODES_PER_TRIANGLE) * i;
+      const index_t node1 = nn + tri_edges_[side];
+      const index_t node2 = nn + tri_edges_[side + 1];
+      const index_t node3 = nn + tri_edges_[side + 2];
 
+      // first triangle
+      Triangle &new_tri_1 = newgrid.conn_[4 * i];
+      new_tri_1[0] = o1;
+      new_tri_1[1] = node1;
+      new_tri_1[2] = node3;
 
-  // reserve memory in newgrid
-  // newgrid contains 4 times the number of triangles of old grid
-  // in worst case, on each triangle three new nodes are created
-  newgrid.reserve(4 * this->num_triangles(), this->num_nodes() + 3 * this->num_triangles());
+      // second triangle
+      Triangle &new_tri_2 = newgrid.conn_[4 * i + 1];
+      new_tri_2[0] = node1;
+      new_tri_2[1] = node2;
+      new_tri_2[2] = node3;
+
+      // third triangle
+      Triangle &new_tri_3 = newgrid.conn_[4 * i + 2];
+      new_tri_3[0] = node1;
+      new_tri_3[1] = o2;
+      new_tri_3[2] = node2;
+
+      // fourth triangle
+      Triangle &new_tri_4 = newgrid.conn_[4 * i + 3];
+      new_tri_4[0] = node3;
+      new_tri_4[1] = node2;
+      new_tri_4[2] = o3;
+    }
+  });
+
+  // every boundary edge is split into two boundary edges of newgrid
+  const count_t nb = boundary_edges_.size();
+  newgrid.boundary_edges_.resize(2 * nb);
+  for(count_t i = 0; i < nb; ++i) {
+    const BoundaryEdge &edge = boundary_edges_[i];
+    const index_t m = nn + find_edge(edge.nodes_[0], edge.nodes_[1]);
+    BoundaryEdge &first = newgrid.boundary_edges_[2 * i];
+    BoundaryEdge &second = newgrid.boundary_edges_[2 * i + 1];
+    first = edge;
+    first.nodes_[1] = m;
+    second = edge;
+    second.nodes_[0] = m;
+  }
+  newgrid.compute_boundary_flag();
+
+  return true;
+}
+
+
+void GRID::refine_ip(
+  const FE_VEC in[],
+  int num_vec,
+  GRID &newgrid,
+  FE_VEC out[],
+  int num_threads
+) {
 
   // check for compatibility of input FE_VECs and old grid
   for(int k = 0; k < num_vec; ++k) {
@@ -99,239 +667,435 @@ void GRID::refine_ip(
     }
   }
 
-  // copy already existing nodes to newgrid
-  for(int j = 0; j < this->num_nodes(); ++j) {
-    newgrid.add_vertex(this->get_coordinates(j));
+  if(!refine_grid(newgrid, num_threads)) {
+    return;
   }
 
-  // allocate enough memory for output FE_VECs
-  // -> in worst case, on each triangle three new nodes are created
-  // copy values of input FE_VECs to output FE_VECs
+  const index_t nn = this->num_nodes();
+  const index_t ne = this->num_edges();
+
+  // copy values of input FE_VECs and interpolate values to the new nodes
+  // via linear interpolation between the values of the nodes defining the
+  // edge in the old grid
   for(int k = 0; k < num_vec; ++k){
-    out[k].resize(this->num_nodes() + 3 * this->num_triangles());
-    for(int j = 0; j < in[k].length(); ++j) {
-      out[k][j] = in[k][j];
-    }
+    out[k].resize(nn + ne);
+    const double *in_values = in[k].getValues().data();
+    double *out_values = out[k].getValues().data();
+    parallel_for(index_t(0), nn, num_threads, [&](index_t begin, index_t end, int) {
+      std::copy(in_values + begin, in_values + end, out_values + begin);
+    });
+    parallel_for(index_t(0), ne, num_threads, [&](index_t begin, index_t end, int) {
+      for(index_t e = begin; e < end; ++e) {
+        out_values[nn + e] = (in_values[edge_node(e, 0)] + in_values[edge_node(e, 1)]) * 0.5;
+      }
+    });
   }
+}
 
 
-  // loop over all triangles
-  for(int i = 0; i < this->num_triangles(); i++){
+void GRID::refine_ip(
+  const FE_MULTIVEC &in,
+  GRID &newgrid,
+  FE_MULTIVEC &out,
+  int num_threads
+) {
 
-    //get nodes in triangle i of old grid
-    o1 = this->get_triangle(i)[0];
-    o2 = this->get_triangle(i)[1];
-    o3 = this->get_triangle(i)[2];
+  // check for compatibility of input FE_MULTIVEC and old grid
+  if(in.length() != this->num_nodes()){
+    std::cout << "Number of nodes in input grid (" << this->num_nodes() << ") and number of nodes in input FE_MULTIVEC ( " << in.length() << ") must match." << std::endl;
+    return;
+  }
 
-    // sort the starting and ending nodes and compute ID unique to each edge
-    // Each edge can uniquely be enumerated by
-    // ID = min(node_number_1, node_number_2) * num_nodes_old + max(node_number_1, node_number_2)
-    // where node_number_{1, 2} denote the numbers of the nodes defining
-    // the edge
-    if(o1 > o2) {
-      entry1 = o2 * this->num_nodes() + o1;
-    } else {
-      entry1 = o1 * this->num_nodes() + o2;
-    }
-    if(o2 > o3) {
-      entry2 = o3 * this->num_nodes() + o2;
-    } else {
-      entry2 = o2 * this->num_nodes() + o3;
-    }
-    if(o3 > o1) {
-      entry3 = o1 * this->num_nodes() + o3;
-    } else {
-      entry3 = o3 * this->num_nodes() + o1;
+  if(!refine_grid(newgrid, num_threads)) {
+    return;
+  }
+
+  const index_t nn = this->num_nodes();
+  const index_t ne = this->num_edges();
+  const int nf = in.num_fields();
+
+  // copy all fields of the old nodes at once and interpolate all fields
+  // of each new node in one go
+  out.resize(nn + ne, nf);
+  for(int f = 0; f < nf; ++f) {
+    out.setName(f, in.getName(f));
+  }
+  std::copy(in.data(), in.data() + static_cast<count_t>(nn) * nf, out.data());
+  parallel_for(index_t(0), ne, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t e = begin; e < end; ++e) {
+      const double *a = in.node(edge_node(e, 0));
+      const double *b = in.node(edge_node(e, 1));
+      double *m = out.node(nn + e);
+      for(int f = 0; f < nf; ++f) {
+        m[f] = (a[f] + b[f]) * 0.5;
+      }
     }
+  });
+}
 
-    // check if needed nodes already exist
-    k1 = this->refinement_info_.find(entry1);
-    k2 = this->refinement_info_.find(entry2);
-    k3 = this->refinement_info_.find(entry3);
 
+void GRID::refine_marked_ip(
+  const std::vector<bool> &marked,
+  const FE_VEC in[],
+  int num_vec,
+  GRID &newgrid,
+  FE_VEC out[]
+) {
 
-    // if new node does not already exist it is created and added to newgrid
-    // don't forget to remember number of new node
+  // newgrid gets new triangles, i.e. tables of a GRID previously stored
+  // in it are not valid anymore
+  newgrid.clear_edge_table();
+  newgrid.renumbered_ = false;
 
-    // first edge
-    if(k1 == this->refinement_info_.end()) { // node in the edge does NOT already exist
+  // check for compatibility of input data and old grid
+  if(static_cast<index_t>(marked.size()) != this->num_triangles()) {
+    std::cout << "Number of triangles in input grid (" << this->num_triangles() << ") and number of marks (" << marked.size() << ") must match." << std::endl;
+    return;
+  }
+  for(int k = 0; k < num_vec; ++k) {
+    if(in[k].length() != this->num_nodes()){
+      std::cout << "Number of nodes in input grid (" << this->num_nodes() << ") and number of elements in input FE_VEC " << k << " ( " << in[k].length() << ") must match." << std::endl;
+      return;
+    }
+  }
 
-      // insert edge ID and number of newly created node
-      this->refinement_info_.insert(std::pair<int, int>(entry1, newgrid.num_nodes()));
+  // (re)build edge table if necessary
+  if(static_cast<count_t>(tri_edges_.size()) != static_cast<count_t>(NODES_PER_TRIANGLE) * this->num_triangles()) {
+    compute_edge_table();
+  }
 
-      // create new node and add it to newgrid
-      Coord new_vertex;
-      new_vertex[0] = (this->get_coordinates(o1)[0] + this->get_coordinates(o2)[0]) * 0.5;
-      new_vertex[1] = (this->get_coordinates(o1)[1] + this->get_coordinates(o2)[1]) * 0.5;
-      newgrid.add_vertex(new_vertex);
+  if(!check_boundary_edges()) {
+    std::cout << "The boundary edges of the GRID are no edges of its triangles." << std::endl;
+    return;
+  }
 
-      // interpolate values to new node via linear interpolation between
-      // the values of the nodes defining the edge in the old grid
-      for(int j = 0; j < num_vec; ++j) {
-        out[j][newgrid.num_nodes()-1] = (out[j][o1] + out[j][o2]) * 0.5;
-      }
+  const index_t nn = this->num_nodes();
+  const index_t ne = this->num_edges();
+  const index_t nt = this->num_triangles();
 
-      // remember number of new node
-      node1 = newgrid.num_nodes()-1;
-    } else { // node DOES already exist
+  // triangles adjacent to each edge (-1 if there is no second triangle)
+  std::vector<index_t> edge_tri(2 * static_cast<count_t>(ne), -1);
+  for(index_t t = 0; t < nt; ++t) {
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      const count_t e = get_triangle_edge(t, s);
+      edge_tri[edge_tri[2*e] < 0 ? 2*e : 2*e+1] = t;
+    }
+  }
 
-      // get number of already existing new node
-      node1 =k1->second;
+  // mark refinement edges of marked triangles and close the marking:
+  // a triangle with a marked edge also needs its refinement edge marked
+  std::vector<char> edge_marked(ne, 0);
+  std::vector<index_t> stack;
+  for(index_t t = 0; t < nt; ++t) {
+    if(marked[t]) {
+      stack.push_back(t);
+    }
+  }
+  while(!stack.empty()) {
+    const index_t t = stack.back();
+    stack.pop_back();
+    const index_t e = get_triangle_edge(t, 0);
+    if(edge_marked[e]) {
+      continue;
+    }
+    edge_marked[e] = 1;
+    // triangles on both sides of e have to be checked again
+    for(int j = 0; j < 2; ++j) {
+      const index_t n = edge_tri[2 * static_cast<count_t>(e) + j];
+      if(n >= 0 && get_triangle_edge(n, 0) != e) {
+        stack.push_back(n);
+      }
     }
+  }
 
-    // second edge
-    if(k2 == this->refinement_info_.end()) { // node in the edge does NOT already exist
+  // check that the numbers of nodes and triangles in newgrid can be
+  // represented by index_t; every marked edge gives a new node and one new
+  // triangle on each of its sides
+  count_t num_new_nodes = 0, num_new_triangles = nt;
+  for(index_t e = 0; e < ne; ++e) {
+    if(edge_marked[e]) {
+      ++num_new_nodes;
+      num_new_triangles += 1 + (edge_tri[2 * static_cast<count_t>(e) + 1] >= 0);
+    }
+  }
+  if(nn + num_new_nodes > std::numeric_limits<index_t>::max() || num_new_triangles > std::numeric_limits<index_t>::max()) {
+    std::cout << "Refined grid (" << nn + num_new_nodes << " nodes, " << num_new_triangles << " triangles) exceeds the range of index_t. Compile with -DGRID_LARGE_INDEX." << std::endl;
+    return;
+  }
 
-      // insert edge ID and number of newly created node
-      this->refinement_info_.insert(std::pair<int, int>(entry2, newgrid.num_nodes()));
+  // number new nodes in the order of the edge numbers
+  refinement_info_.assign(ne, -1);
+  index_t new_nodes = 0;
+  for(index_t e = 0; e < ne; ++e) {
+    if(edge_marked[e]) {
+      refinement_info_[e] = nn + new_nodes++;
+    }
+  }
 
-      // create new node and add it to newgrid
-      Coord new_vertex;
-      new_vertex[0] = (this->get_coordinates(o2)[0] + this->get_coordinates(o3)[0]) * 0.5;
-      new_vertex[1] = (this->get_coordinates(o2)[1] + this->get_coordinates(o3)[1]) * 0.5;
-      newgrid.add_vertex(new_vertex);
+  // copy old nodes and create new nodes in the middle of the marked edges
+  for(int d = 0; d < NDIM; ++d) {
+    newgrid.coords_[d].resize(nn + new_nodes);
+    std::copy(coords_[d].begin(), coords_[d].end(), newgrid.coords_[d].begin());
+    for(index_t e = 0; e < ne; ++e) {
+      if(refinement_info_[e] >= 0) {
+        newgrid.coords_[d][refinement_info_[e]] = (coords_[d][edge_node(e, 0)] + coords_[d][edge_node(e, 1)]) * 0.5;
+      }
+    }
+  }
 
-      // interpolate values to new node via linear interpolation between
-      // the values of the nodes defining the edge in the old grid
-      for(int j = 0; j < num_vec; ++j) {
-        out[j][newgrid.num_nodes()-1] = (out[j][o2] + out[j][o3]) * 0.5;
+  // copy values of input FE_VECs and interpolate them linearly to the new
+  // nodes
+  for(int k = 0; k < num_vec; ++k){
+    out[k].resize(nn + new_nodes);
+    for(index_t j = 0; j < nn; ++j) {
+      out[k][j] = in[k][j];
+    }
+    for(index_t e = 0; e < ne; ++e) {
+      if(refinement_info_[e] >= 0) {
+        out[k][refinement_info_[e]] = (in[k][edge_node(e, 0)] + in[k][edge_node(e, 1)]) * 0.5;
       }
+    }
+  }
+
+  // create new triangles. Bisection of (a0, a1, a2) with new node q in the
+  // refinement edge (a0, a1) gives the children (a2, a0, q) and (a1, a2, q),
+  // whose refinement edges are the old sides 2 and 1 of the parent. These
+  // are bisected again if they are marked.
+  newgrid.conn_.clear();
+  newgrid.conn_.reserve(num_new_triangles);
+  for(index_t t = 0; t < nt; ++t) {
+    const Triangle &tri = conn_[t];
+    const index_t m = refinement_info_[get_triangle_edge(t, 0)];
+    if(m < 0) {
+      newgrid.conn_.push_back(tri);
+      continue;
+    }
 
-      // remember number of new node
-      node2 = newgrid.num_nodes()-1;
-    } else { // node DOES already exist
+    Triangle child[2];
+    child[0][0] = tri[2]; child[0][1] = tri[0]; child[0][2] = m;
+    child[1][0] = tri[1]; child[1][1] = tri[2]; child[1][2] = m;
+    const index_t m_child[2] = {refinement_info_[get_triangle_edge(t, 2)], refinement_info_[get_triangle_edge(t, 1)]};
 
-      // get number of already existing new node
-      node2 = k2->second;
+    for(int c = 0; c < 2; ++c) {
+      if(m_child[c] < 0) {
+        newgrid.conn_.push_back(child[c]);
+      } else {
+        Triangle grandchild;
+        grandchild[0] = child[c][2]; grandchild[1] = child[c][0]; grandchild[2] = m_child[c];
+        newgrid.conn_.push_back(grandchild);
+        grandchild[0] = child[c][1]; grandchild[1] = child[c][2]; grandchild[2] = m_child[c];
+        newgrid.conn_.push_back(grandchild);
+      }
     }
+  }
 
-    // third edge
-    if(k3 == this->refinement_info_.end()) { // node in the edge does NOT already exist
+  // bisected boundary edges are replaced by their two halves
+  newgrid.boundary_edges_.clear();
+  for(std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+    const BoundaryEdge &edge = boundary_edges_[i];
+    const index_t m = refinement_info_[find_edge(edge.nodes_[0], edge.nodes_[1])];
+    if(m < 0) {
+      newgrid.boundary_edges_.push_back(edge);
+      continue;
+    }
+    BoundaryEdge half = edge;
+    half.nodes_[1] = m;
+    newgrid.boundary_edges_.push_back(half);
+    half = edge;
+    half.nodes_[0] = m;
+    newgrid.boundary_edges_.push_back(half);
+  }
+  newgrid.compute_boundary_flag();
+}
 
-      // insert edge ID and number of newly created node
-      this->refinement_info_.insert(std::pair<int, int>(entry3, newgrid.num_nodes()));
 
-      // create new node and add it to newgrid
-      Coord new_vertex;
-      new_vertex[0] = (this->get_coordinates(o3)[0] + this->get_coordinates(o1)[0]) * 0.5;
-      new_vertex[1] = (this->get_coordinates(o3)[1] + this->get_coordinates(o1)[1]) * 0.5;
-      newgrid.add_vertex(new_vertex);
+/// Number of bits per coordinate used for the Hilbert curve indices
+static const int HILBERT_ORDER = 21;
 
-      // interpolate values to new node via linear interpolation between
-      // the values of the nodes defining the edge in the old grid
-      for(int j = 0; j < num_vec; ++j) {
-        out[j][newgrid.num_nodes()-1] = (out[j][o3] + out[j][o1]) * 0.5;
+/// Index of the point (x, y) with 0 <= x, y < 2^HILBERT_ORDER on the
+/// Hilbert curve
+static uint64_t hilbert_index(uint32_t x, uint32_t y) {
+  uint64_t d = 0;
+  for(uint32_t s = 1u << (HILBERT_ORDER - 1); s > 0; s >>= 1) {
+    const uint32_t rx = (x & s) > 0;
+    const uint32_t ry = (y & s) > 0;
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    // rotate quadrant
+    if(ry == 0) {
+      if(rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
       }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+/// Compute the permutation which sorts the given keys; perm[i] is the
+/// position of entry i in the sorted order. Equal keys keep their order.
+static void sort_permutation(const std::vector<uint64_t> &keys, std::vector<index_t> &perm) {
+  std::vector<std::pair<uint64_t, index_t> > order(keys.size());
+  for(std::size_t i = 0; i < keys.size(); ++i) {
+    order[i] = std::make_pair(keys[i], static_cast<index_t>(i));
+  }
+  std::sort(order.begin(), order.end());
+  perm.resize(keys.size());
+  for(std::size_t i = 0; i < keys.size(); ++i) {
+    perm[order[i].second] = static_cast<index_t>(i);
+  }
+}
+
+void GRID::renumber_hilbert(
+  std::vector<index_t> &node_perm,
+  std::vector<index_t> &tri_perm,
+  int num_threads
+) {
 
-      // remember number of new node
-      node3 = newgrid.num_nodes()-1;
-    } else { // node DOES already exist
+  const index_t nn = this->num_nodes();
+  const index_t nt = this->num_triangles();
+  if(nn == 0) {
+    node_perm.clear();
+    tri_perm.clear();
+    return;
+  }
+
+  // bounding box of the GRID
+  double lo[NDIM], scale[NDIM];
+  for(int d = 0; d < NDIM; ++d) {
+    const double min = *std::min_element(coords_[d].begin(), coords_[d].end());
+    const double max = *std::max_element(coords_[d].begin(), coords_[d].end());
+    lo[d] = min;
+    scale[d] = max > min ? ((1u << HILBERT_ORDER) - 1) / (max - min) : 0.0;
+  }
 
-      // get number of already existing new node
-      node3 = k3->second;
+  // curve indices of nodes and of triangle centroids
+  std::vector<uint64_t> node_key(nn);
+  parallel_for(index_t(0), nn, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t i = begin; i < end; ++i) {
+      node_key[i] = hilbert_index(static_cast<uint32_t>((coords_[0][i] - lo[0]) * scale[0]),
+                                  static_cast<uint32_t>((coords_[1][i] - lo[1]) * scale[1]));
+    }
+  });
+  std::vector<uint64_t> tri_key(nt);
+  parallel_for(index_t(0), nt, num_threads, [&](index_t begin, index_t end, int) {
+    for(index_t t = begin; t < end; ++t) {
+      double c[NDIM];
+      for(int d = 0; d < NDIM; ++d) {
+        c[d] = (coords_[d][conn_[t][0]] + coords_[d][conn_[t][1]] + coords_[d][conn_[t][2]]) / 3.0;
+      }
+      tri_key[t] = hilbert_index(static_cast<uint32_t>((c[0] - lo[0]) * scale[0]),
+                                 static_cast<uint32_t>((c[1] - lo[1]) * scale[1]));
     }
+  });
 
+  sort_permutation(node_key, node_perm);
+  sort_permutation(tri_key, tri_perm);
 
-    //create the new triangles and them to newgrid
+  // permute nodes and node data
+  for(int d = 0; d < NDIM; ++d) {
+    std::vector<double, AlignedAllocator<double> > new_coords(nn);
+    for(index_t i = 0; i < nn; ++i) {
+      new_coords[node_perm[i]] = coords_[d][i];
+    }
+    coords_[d].swap(new_coords);
+  }
+  for(std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+    for(int j = 0; j < 2; ++j) {
+      boundary_edges_[i].nodes_[j] = node_perm[boundary_edges_[i].nodes_[j]];
+    }
+  }
+  compute_boundary_flag();
 
-    // first triangle
-    Triangle new_tri_1;
-    new_tri_1[0] = o1;
-    new_tri_1[1] = node1;
-    new_tri_1[2] = node3;
-    newgrid.add_triangle(new_tri_1);
+  // permute triangles and renumber their vertices
+  std::vector<Triangle> new_conn(nt);
+  for(index_t t = 0; t < nt; ++t) {
+    Triangle &tri = new_conn[tri_perm[t]];
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      tri[s] = node_perm[conn_[t][s]];
+    }
+  }
+  conn_.swap(new_conn);
 
-    // second triangle
-    Triangle new_tri_2;
-    new_tri_2[0] = node1;
-    new_tri_2[1] = node2;
-    new_tri_2[2] = node3;
-    newgrid.add_triangle(new_tri_2);
+  // edge numbers are not valid anymore
+  clear_edge_table();
+  renumbered_ = true;
+}
 
-    // third triangle
-    Triangle new_tri_3;
-    new_tri_3[0] = node1;
-    new_tri_3[1] = o2;
-    new_tri_3[2] = node2;
-    newgrid.add_triangle(new_tri_3);
 
-    // fourth triangle
-    Triangle new_tri_4;
-    new_tri_4[0] = node3;
-    new_tri_4[1] = node2;
-    new_tri_4[2] = o3;
-    newgrid.add_triangle(new_tri_4);
+void GRID::compute_boundary_edges(int num_threads) {
+
+  // (re)build edge table if necessary
+  if(static_cast<count_t>(tri_edges_.size()) != static_cast<count_t>(NODES_PER_TRIANGLE) * this->num_triangles()) {
+    compute_edge_table(num_threads);
   }
 
-  // resive ouput FE_VECs to final (and correct) size
-  // i.e. number of nodes in newgrid
-  for(int j = 0; j < num_vec; j++){
-    out[j].resize(newgrid.num_nodes());
+  // count triangles per edge; edges with only one triangle are on the
+  // boundary
+  std::vector<unsigned char> tri_count(num_edges(), 0);
+  for(index_t t = 0; t < num_triangles(); ++t) {
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      unsigned char &count = tri_count[get_triangle_edge(t, s)];
+      count = std::min(count + 1, 2);
+    }
   }
 
-  // Initialize further data on newgrid
-  newgrid.init();
+  boundary_edges_.clear();
+  for(index_t t = 0; t < num_triangles(); ++t) {
+    for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+      if(tri_count[get_triangle_edge(t, s)] == 1) {
+        BoundaryEdge edge;
+        edge.nodes_[0] = conn_[t][s];
+        edge.nodes_[1] = conn_[t][(s+1) % NODES_PER_TRIANGLE];
+        edge.tag_ = 0;
+        boundary_edges_.push_back(edge);
+      }
+    }
+  }
 }
 
-
 void GRID::compute_boundary_flag() {
   
   // clear possible old values in boundary_flag_
   boundary_flag_.clear();
   // initialize boundary_flag_ with false
   boundary_flag_.resize(num_nodes(), false);
-  Triangle t;
-  std::vector<int> t_count(num_nodes(), 0);
-  // count number of triangles every node is contained in
-  for(int i= 0; i< num_triangles(); i++){
-    t = get_triangle(i);
-    for(int i=0; i< NODES_PER_TRIANGLE; i++){
-      t_count[t[i]]++; 
+  // the end nodes of all boundary edges are on the boundary
+  for(std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+    for(int j = 0; j < 2; ++j) {
+      boundary_flag_[boundary_edges_[i].nodes_[j]] = true;
     }
   }
-  // if a node is in one, two or three triangles, it must be on the border, else it is not.
-  for(int i=0; i<num_nodes(); i++){
-    boundary_flag_[i] = t_count[i] <= 3;
-  }
 
+  compute_boundary_index();
 }
 
-void GRID::compute_dirichlet_nodes_and_values(void (*function_to_call)(GRID&, const std::vector<int>&, std::vector<double>&),
-                                        std::vector<int> &dirichlet_nodes,
-                                        std::vector<double> &dirichlet_val)
-{
-  // according to task b
-  Triangle t;
-  int a, b;
-  std::vector<int> bd_pts(2);
-  std::vector<bool> is_already(num_nodes());
-  //iter ofer triangles
-  for(int i = 0; i<num_triangles(); i++){
-    t = get_triangle(i);
-    // iter over edges
-    for(int e = 0; e < NODES_PER_TRIANGLE; e++ ){
-      a = t[e];
-      b = t[(e+1) % NODES_PER_TRIANGLE];
-      //check if edge is on boundary
-      if(boundary_flag_[a] && boundary_flag_[b]){
-        std::vector<double> bd_vals;
-        bd_pts[0] = a;
-        bd_pts[1] = b;
-        (*function_to_call)(*this, bd_pts, bd_vals);
-        if(bd_vals.size()==2){
-          // vec entrys must be unique
-          if(!is_already[a]){
-            dirichlet_nodes.push_back(a);
-            dirichlet_val.push_back(bd_vals[0]);
-            is_already[a] = true;
-          }
-          if(!is_already[b]){
-              dirichlet_nodes.push_back(b);
-              dirichlet_val.push_back(bd_vals[1]);
-              is_already[b] = true;
-          } 
-        }
-      }
+void GRID::compute_boundary_index() {
+
+  // per-tag node index: sort the (tag, node) pairs of all edge end nodes
+  std::vector<std::pair<int, index_t> > tag_node(2 * boundary_edges_.size());
+  for(std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+    for(int j = 0; j < 2; ++j) {
+      tag_node[2*i + j] = std::make_pair(boundary_edges_[i].tag_, boundary_edges_[i].nodes_[j]);
     }
   }
+  std::sort(tag_node.begin(), tag_node.end());
+  tag_node.erase(std::unique(tag_node.begin(), tag_node.end()), tag_node.end());
+
+  boundary_tags_.clear();
+  tag_node_ptr_.clear();
+  tag_nodes_.resize(tag_node.size());
+  for(std::size_t i = 0; i < tag_node.size(); ++i) {
+    if(i == 0 || tag_node[i].first != tag_node[i-1].first) {
+      boundary_tags_.push_back(tag_node[i].first);
+      tag_node_ptr_.push_back(i);
+    }
+    tag_nodes_[i] = tag_node[i].second;
+  }
+  tag_node_ptr_.push_back(tag_node.size());
+
+  // all boundary nodes
+  boundary_nodes_.assign(tag_nodes_.begin(), tag_nodes_.end());
+  std::sort(boundary_nodes_.begin(), boundary_nodes_.end());
+  boundary_nodes_.erase(std::unique(boundary_nodes_.begin(), boundary_nodes_.end()), boundary_nodes_.end());
 }
@@ -4,12 +4,16 @@
 #define _GRID_H_
 
 #include <cmath>
+#include <cstdio>
 #include <utility>
 #include <string>
 #include <vector>
-#include <unordered_map>
 #include <cassert>
+#include <algorithm>
 
+#include "index.h"
+#include "aligned_allocator.h"
+#include "parallel.h"
 #include "FE_VEC.h"
 
 const int NDIM = 2;
@@ -47,12 +51,12 @@ struct Triangle {
 
   /// Array for the three vertices; entries have to be ordered in counter-
   /// clockwise order
-  int vertices_[NODES_PER_TRIANGLE];
+  index_t vertices_[NODES_PER_TRIANGLE];
 
   /// Access the number of the i-th vertex of the triangle
   /// Return value in the node number wrt. the GRID in which this triangle
   /// is contained
-  int& operator[](int i) {
+  index_t& operator[](int i) {
     assert(i < NODES_PER_TRIANGLE);
     return vertices_[i];
   }
@@ -60,16 +64,32 @@ struct Triangle {
   /// Access the number of the i-th vertex of the triangle
   /// Return value in the node number wrt. the GRID in which this triangle
   /// is contained
-  int operator[](int i) const {
+  index_t operator[](int i) const {
     assert(i < NODES_PER_TRIANGLE);
     return vertices_[i];
   }
 };
 
+/// @brief Structure for an edge on the boundary of a GRID
+/// A boundary edge is defined by the numbers of its two end nodes and an
+/// integer tag, e.g. the physical group of a Gmsh mesh, which can be used
+/// to select boundary conditions
+struct BoundaryEdge {
+
+  /// End nodes of the edge in the order of the triangle containing it,
+  /// i.e. the GRID lies to the left of the edge
+  index_t nodes_[2];
+
+  /// Tag of the edge, 0 if it has no tag
+  int tag_;
+};
+
 /*****************************************************************************/
 /* Structures                                                                */
 /*****************************************************************************/
 
+class FE_MULTIVEC;
+
 /// @brief Class for computational grid. Holds geometry information via
 /// coordinates of points and information about the triangulation.
 class GRID {
@@ -78,14 +98,39 @@ private:
 	/// the GRID
 	std::vector<Triangle> conn_;
 
-	/// Vector of nodes/points/vertices in the GRID.
-	std::vector<Coord> coords_;
+	/// Coordinates of the nodes/points/vertices in the GRID in
+	/// structure-of-arrays layout, i.e. coords_[d][i] is the d-th
+	/// coordinate of node i. The arrays are aligned to SIMD_ALIGNMENT bytes.
+	std::vector<double, AlignedAllocator<double> > coords_[NDIM];
 
 	/// Information about the refinement to the next finer level
-	/// The first int (key) denotes a unique(!) ID for each edge in the GRID
-	/// The second int (value) denotes the number of the newly created
-	/// node in the specific edge wrt. to the node numbering in the finer GRID
-	std::unordered_map<int, int> refinement_info_;
+	/// refinement_info_[e] denotes the number of the newly created node
+	/// in edge e (see edge table below) wrt. to the node numbering in
+	/// the finer GRID, or -1 if edge e has not been refined
+	std::vector<index_t> refinement_info_;
+
+	/// Edge table in compressed row storage (CSR) format
+	/// Every edge (v, w) with v < w is stored in row v, i.e. the edges
+	/// starting in node v have the end nodes
+	/// edge_target_[edge_ptr_[v]], ..., edge_target_[edge_ptr_[v+1]-1]
+	/// and the (dense) edge numbers edge_index_[edge_ptr_[v]], ...
+	std::vector<index_t> edge_ptr_;
+	std::vector<index_t> edge_target_;
+	std::vector<index_t> edge_index_;
+
+	/// Edge number of each side of each triangle
+	/// Side s of triangle t connects the vertices t[s] and t[(s+1)%3] and
+	/// has the edge number tri_edges_[3*t+s]
+	std::vector<index_t> tri_edges_;
+
+	/// Nodes defining the edges
+	/// Edge e connects the nodes edge_nodes_[2*e] and edge_nodes_[2*e+1]
+	std::vector<index_t> edge_nodes_;
+
+	/// True if the nodes have been renumbered by renumber_hilbert since
+	/// the GRID has been read or created by refinement, i.e. if the
+	/// refinement information of the coarser GRID does not fit anymore
+	bool renumbered_;
 
 
 	/// Information which nodes are on the boundary
@@ -93,17 +138,80 @@ private:
 	/// otherwise, boundary_flag_[i] is false for interior nodes
 	std::vector<bool> boundary_flag_;
 
-	/// Compute flag boundary_flag_ of type std::vector<bool> to mark boundary nodes
+	/// Edges on the boundary of the GRID, i.e. sides of exactly one
+	/// triangle, with their tags
+	/// They are computed from the edge adjacency when a GRID is read (see
+	/// compute_boundary_edges) and inherited by refined GRIDs: refine_ip
+	/// splits boundary edge i into the edges 2*i and 2*i+1 of the new GRID.
+	std::vector<BoundaryEdge> boundary_edges_;
+
+	/// Numbers of all boundary nodes in ascending order
+	std::vector<index_t> boundary_nodes_;
+
+	/// Boundary nodes per tag in compressed row storage (CSR) format
+	/// boundary_tags_ are the distinct tags of the boundary edges in
+	/// ascending order; the end nodes of the edges with tag boundary_tags_[k]
+	/// are tag_nodes_[tag_node_ptr_[k]], ..., tag_nodes_[tag_node_ptr_[k+1]-1]
+	/// in ascending order
+	std::vector<int> boundary_tags_;
+	std::vector<count_t> tag_node_ptr_;
+	std::vector<index_t> tag_nodes_;
+
+	/// Buffers for compute_dirichlet_bc, kept to avoid reallocation:
+	/// coordinates of the boundary nodes, values and flags returned by the
+	/// evaluator
+	std::vector<double, AlignedAllocator<double> > boundary_coords_[NDIM];
+	std::vector<double, AlignedAllocator<double> > boundary_values_;
+	std::vector<unsigned char> boundary_is_dirichlet_;
+
+	/// Compute boundary_edges_ from the edge table, i.e. find all sides
+	/// which belong to only one triangle; all tags are set to 0
+	/// The edges are ordered as they are met in a loop over all triangles
+	/// and their sides.
+	void compute_boundary_edges(int num_threads = 1);
+
+	/// Check that all boundary_edges_ are edges of the GRID, e.g. after
+	/// they have been read from a file; builds the edge table if necessary
+	/// Called wherever the edge table is needed anyway, i.e. before
+	/// refinement and when tags are assigned
+	bool check_boundary_edges();
+
+	/// Compute flag boundary_flag_ of type std::vector<bool> to mark boundary nodes,
+	/// the list boundary_nodes_ and the per-tag index tag_nodes_
+	/// A node is a boundary node if it belongs to a boundary edge
+	/// Needs to be called again whenever the tags of boundary_edges_ change
 	void compute_boundary_flag();
 
+	/// Compute boundary_nodes_ and the per-tag index tag_nodes_ from
+	/// boundary_edges_, see compute_boundary_flag
+	void compute_boundary_index();
+
+	/// Refine GRID uniformly into newgrid, see refine_ip
+	/// Returns false if newgrid would be too large for index_t
+	bool refine_grid(GRID &newgrid, int num_threads);
+
+	/// Thread parallel version of compute_edge_table()
+	/// Each edge is owned by the triangle with the smallest number
+	/// containing it. The owned edges are counted per chunk of triangles
+	/// and numbered after a prefix sum over the chunks, which gives the
+	/// same numbering as the serial version.
+	void compute_edge_table_parallel(int num_threads);
+
+	/// Drop the edge table and refinement_info_ whenever the triangles
+	/// are replaced; the edge table is rebuilt on demand, which is only
+	/// detected by its size otherwise
+	void clear_edge_table();
+
 public:
 	/// Default constructor
-        GRID() {
+        GRID() : renumbered_(false) {
 		init();
         }
 
 	/// Call several routines to intialize further data in GRID
-	void init() {
+	/// Needs to be called after the triangles of the GRID have been set up
+	void init(int num_threads = 1) {
+		compute_boundary_edges(num_threads);
 		compute_boundary_flag();
 	}
 
@@ -112,35 +220,84 @@ public:
 	/// of entries in the respective vectors because it helps to prevent
 	/// unnecessary reallocation of the content of the vectors during the
 	/// addition of further entries
-        void reserve(int num_tri, int num_vertex) {
-			coords_.reserve(num_vertex);
+        void reserve(index_t num_tri, index_t num_vertex) {
+			for(int d = 0; d < NDIM; ++d) {
+				coords_[d].reserve(num_vertex);
+			}
 			conn_.reserve(num_tri);
 		}
 
         /// Get total number of nodes in Grid
-        int num_nodes() const {
-          return coords_.size();
+        index_t num_nodes() const {
+          return coords_[0].size();
         }
 
         /// Get total number of triangles in Grid
-        int num_triangles() const {
+        index_t num_triangles() const {
           return conn_.size();
         }
 
+        /// Get total number of edges in Grid
+	/// Only valid after compute_edge_table() has been called
+        index_t num_edges() const {
+          return edge_nodes_.size() / 2;
+        }
+
+	/// Get node j (0 or 1) of edge e
+	/// Only valid after compute_edge_table() has been called
+	index_t edge_node(index_t e, int j) const {
+		return edge_nodes_[2 * static_cast<count_t>(e) + j];
+	}
+
         /// Get Triangle number tri_index
-        Triangle& get_triangle(int tri_index) {
+        Triangle& get_triangle(index_t tri_index) {
 	  assert(tri_index >= 0);
-          assert(tri_index < static_cast<int>(conn_.size()));
+          assert(tri_index < static_cast<index_t>(conn_.size()));
           return conn_[tri_index];
         }
 
         /// Get Coordinates of vertex point_index
-        Coord& get_coordinates(int point_index) {
+        Coord get_coordinates(index_t point_index) const {
 	  assert(point_index >= 0);
-          assert(point_index < static_cast<int>(coords_.size()));
-          return coords_[point_index];
+          assert(point_index < num_nodes());
+          Coord c;
+          for(int d = 0; d < NDIM; ++d) {
+            c[d] = coords_[d][point_index];
+          }
+          return c;
         }
 
+        /// Set Coordinates of vertex point_index
+        void set_coordinates(index_t point_index, const Coord &c) {
+	  assert(point_index >= 0);
+          assert(point_index < num_nodes());
+          for(int d = 0; d < NDIM; ++d) {
+            coords_[d][point_index] = c[d];
+          }
+        }
+
+	/// Get the d-th coordinate of all vertices as contiguous array of
+	/// length num_nodes(), aligned to SIMD_ALIGNMENT bytes
+	/// Use this for loops over many vertices, e.g.
+	/// x = coordinates(0), y = coordinates(1); ... x[i] ... y[i] ...
+	const double* coordinates(int d) const {
+		assert(d >= 0 && d < NDIM);
+		return coords_[d].data();
+	}
+
+	/// Get the d-th coordinate of all vertices, see above
+	double* coordinates(int d) {
+		assert(d >= 0 && d < NDIM);
+		return coords_[d].data();
+	}
+
+	/// Get all triangles as contiguous array of length num_triangles(),
+	/// i.e. the vertices of all triangles as contiguous array of length
+	/// NODES_PER_TRIANGLE * num_triangles()
+	const Triangle* triangles() const {
+		return conn_.data();
+	}
+
         /// Add Triangle
 	/// New triangle will be added as "last" triangle in the GRID,
 	/// i.e. its number is num_triangles() (before insertion) + 1
@@ -151,76 +308,565 @@ public:
         /// Add Vertex
 	/// New vertex will be added as "last" vertex in the GRID,
 	/// i.e. its number is num_nodes() (before insertion) + 1
-        void add_vertex(Coord &new_vertex) {
-          coords_.push_back(new_vertex);
+        void add_vertex(const Coord &new_vertex) {
+          for(int d = 0; d < NDIM; ++d) {
+            coords_[d].push_back(new_vertex[d]);
+          }
         }
 
+	/// Get boundary edges with their tags, see boundary_edges_
+	const std::vector<BoundaryEdge>& boundary_edges() const {
+		return boundary_edges_;
+	}
+
+	/// Get numbers of all boundary nodes in ascending order
+	const std::vector<index_t>& boundary_nodes() const {
+		return boundary_nodes_;
+	}
+
+	/// Get distinct tags of the boundary edges in ascending order
+	const std::vector<int>& boundary_tags() const {
+		return boundary_tags_;
+	}
+
+	/// Get end nodes of all boundary edges with the given tag in ascending
+	/// order, see tag_nodes_
+	/// @param[in] tag tag of the boundary edges
+	/// @param[out] num number of nodes, 0 if no boundary edge has this tag
+	/// @return pointer to the first node
+	const index_t* tagged_boundary_nodes(int tag, count_t &num) const {
+		const std::vector<int>::const_iterator it =
+			std::lower_bound(boundary_tags_.begin(), boundary_tags_.end(), tag);
+		if(it == boundary_tags_.end() || *it != tag) {
+			num = 0;
+			return tag_nodes_.data();
+		}
+		const std::size_t k = it - boundary_tags_.begin();
+		num = tag_node_ptr_[k+1] - tag_node_ptr_[k];
+		return tag_nodes_.data() + tag_node_ptr_[k];
+	}
+
 	/// Generate FE_VEC representation of boundary_flag_
 	void boundary_flag_to_FE_VEC(FE_VEC &vec) {
 		vec.resize(num_nodes());
-		for(int i = 0; i < num_nodes(); ++i) {
+		for(index_t i = 0; i < num_nodes(); ++i) {
 			vec[i] = static_cast<double>(boundary_flag_[i]);
 		}
 	}
 
 	
-	/// Compute Dirichlet boundary nodes and corresponding values
-	/// @param[in] function_to_call pointer to Dirichlet BC evaluator function, e.g. Dirichlet_BC_exercise_3, which needs to have the given signature
-	/// @param[out] dirichlet_nodes contains the indices of nodes which are on Dirichlet boundary
-	/// @param[out] dirichlet_val contains the values at the Dirichlet nodes specified in dirichlet_nodes
-	void compute_dirichlet_nodes_and_values(void (*function_to_call)(GRID&, const std::vector<int>&, std::vector<double>&),
-                                          std::vector<int> &dirichlet_nodes,
-                                          std::vector<double> &dirichlet_val);
+	/// Evaluate a function at all nodes of the GRID
+	/// The nodes are split into blocks of NODAL_BLOCK_SIZE nodes (the last
+	/// one may be shorter) and for each block evaluator is called as
+	///   evaluator(n, coords, values)
+	/// with the number n of nodes in the block, coords[d] pointing to the
+	/// d-th coordinates of these nodes (see coordinates()) and values to
+	/// their entries in vec. It has to set values[i] for i < n. The blocks
+	/// start at aligned nodes, i.e. evaluator can run a plain loop over the
+	/// structure-of-arrays coordinates which the compiler vectorizes, with
+	/// -Ofast including calls of sin, exp etc. (via the vector math library
+	/// of glibc). The blocks are distributed to num_threads threads.
+	/// @param[in] evaluator function to evaluate, e.g. FunctionSheet2
+	/// @param[out] vec function values at the nodes; resized to num_nodes()
+	/// @param[in] num_threads number of threads
+	template<class F>
+	void evaluate(F evaluator, FE_VEC &vec, int num_threads = 1) const;
+
+	/// Number of nodes per block in evaluate(); every block starts at a
+	/// SIMD_ALIGNMENT aligned address
+	static constexpr count_t NODAL_BLOCK_SIZE = 4096;
+
+	/// Compute Dirichlet boundary nodes and corresponding values with a
+	/// batched evaluator
+	/// The coordinates of all boundary nodes (see boundary_nodes()) are
+	/// gathered into contiguous arrays and evaluator is called once as
+	///   evaluator(n, coords, values, is_dirichlet)
+	/// with the number n of boundary nodes and coords[d][i] the d-th
+	/// coordinate of the i-th boundary node. It has to set values[i] to the
+	/// boundary value and is_dirichlet[i] to 1 if the i-th boundary node is
+	/// a Dirichlet node, to 0 otherwise. The evaluator is a template
+	/// parameter, i.e. a function object or lambda can be inlined and its
+	/// loop over the nodes vectorized. No memory is allocated after the
+	/// first call apart from growing the output vectors.
+	/// @param[in] evaluator evaluator of the boundary condition, e.g. DirichletBCExercise3
+	/// @param[out] dirichlet_nodes indices of the Dirichlet nodes in ascending order; old contents are replaced
+	/// @param[out] dirichlet_val values at the Dirichlet nodes specified in dirichlet_nodes
+	template<class F>
+	void compute_dirichlet_bc(F evaluator,
+	                          std::vector<index_t> &dirichlet_nodes,
+	                          std::vector<double> &dirichlet_val);
+
+	/// Compute Dirichlet boundary nodes and corresponding values on the
+	/// boundary edges with the given tags
+	/// The Dirichlet nodes are taken from the per-tag node index (see
+	/// tagged_boundary_nodes()), i.e. no geometric tests are needed. Their
+	/// coordinates are gathered as in compute_dirichlet_bc above and
+	/// evaluator is called once as
+	///   evaluator(n, coords, values)
+	/// It has to set values[i] to the boundary value of the i-th node.
+	/// @param[in] tags tags of the Dirichlet boundary edges
+	/// @param[in] evaluator evaluator of the boundary values, e.g. DirichletValuesExercise3
+	/// @param[out] dirichlet_nodes indices of the Dirichlet nodes in ascending order; old contents are replaced
+	/// @param[out] dirichlet_val values at the Dirichlet nodes specified in dirichlet_nodes
+	template<class F>
+	void compute_dirichlet_bc(const std::vector<int> &tags,
+	                          F evaluator,
+	                          std::vector<index_t> &dirichlet_nodes,
+	                          std::vector<double> &dirichlet_val);
+
+	/// Derive the Dirichlet boundary nodes and values on the finer GRID
+	/// from those on this GRID
+	/// finer has to be generated from this GRID by refine_ip or
+	/// refine_marked_ip and neither GRID may be renumbered (see
+	/// renumber_hilbert) since; otherwise false is returned and
+	/// dirichlet_nodes and dirichlet_val are not changed. Then the nodes
+	/// of this GRID keep their numbers and the Dirichlet nodes of finer
+	/// are those of this GRID plus the new nodes on the refined boundary
+	/// edges with the given tags (see refinement_info_). Only the values at
+	/// these new nodes are evaluated, as in the tag based
+	/// compute_dirichlet_bc, i.e. the effort is proportional to the number
+	/// of new Dirichlet nodes. The result is the same as the one of
+	/// compute_dirichlet_bc on finer, up to rounding differences of the
+	/// evaluator between batches of different length.
+	/// @param[in] tags tags of the Dirichlet boundary edges
+	/// @param[in] evaluator evaluator of the boundary values, e.g. DirichletValuesExercise3
+	/// @param[in] finer GRID refined from this GRID; its buffers are used for the coordinates
+	/// @param[in,out] dirichlet_nodes Dirichlet nodes of this GRID as computed by compute_dirichlet_bc with the same tags, replaced by those of finer
+	/// @param[in,out] dirichlet_val values at dirichlet_nodes, replaced by those of finer
+	/// @return false if the refinement information does not fit finer
+	template<class F>
+	bool refine_dirichlet_bc(const std::vector<int> &tags,
+	                         F evaluator,
+	                         GRID &finer,
+	                         std::vector<index_t> &dirichlet_nodes,
+	                         std::vector<double> &dirichlet_val) const;
+
+	/// Compute edge table, i.e. edge_ptr_, edge_target_, edge_index_,
+	/// tri_edges_ and edge_nodes_
+	/// The edges are numbered in the order in which they are first met
+	/// in a loop over all triangles and their sides
+	/// @param[in] num_threads number of threads; the resulting table does
+	/// not depend on the number of threads
+	void compute_edge_table(int num_threads = 1);
+
+	/// Get number of the edge on side s of triangle t, i.e. the edge
+	/// connecting the vertices t[s] and t[(s+1)%3]
+	/// Only valid after compute_edge_table() has been called
+	index_t get_triangle_edge(index_t t, int s) const {
+		return tri_edges_[static_cast<count_t>(NODES_PER_TRIANGLE) * t + s];
+	}
+
+	/// Get number of the edge connecting the nodes a and b
+	/// Returns -1 if there is no such edge. Needs the edge table, see
+	/// compute_edge_table()
+	index_t find_edge(index_t a, index_t b) const {
+		if(a > b) {
+			std::swap(a, b);
+		}
+		for(index_t k = edge_ptr_[a]; k < edge_ptr_[a+1]; ++k) {
+			if(edge_target_[k] == b) {
+				return edge_index_[k];
+			}
+		}
+		return -1;
+	}
 
         /// Read grid from given files
 	/// Coordinates of vertices and connectivity information for the
 	/// triangles are loaded from seperate files
+	/// The coordinates file contains one node per line (NDIM numbers),
+	/// the connectivity file one triangle per line (three 1-based node
+	/// numbers); blank lines are ignored. The files are memory mapped
+	/// and parsed by num_threads threads.
         void read_from_file(
           const char* coords_filename,
-          const char* conn_filename
+          const char* conn_filename,
+          int num_threads = 1
         );
 
+	/// Read tags of boundary edges from given file
+	/// The file contains one boundary segment per line: the 1-based numbers
+	/// of its two end nodes and its tag; blank lines are ignored. Each
+	/// segment has to be a boundary edge of the GRID, in any orientation.
+	/// Boundary edges which are not listed keep their tag. The tags are
+	/// inherited by refined GRIDs.
+	void read_boundary_tags(const char* filename);
+
+	/// Read grid from a Gmsh mesh file in binary MSH 4.1 format
+	/// All 3-node triangles are read into the GRID, the z coordinate is
+	/// ignored. Nodes are renumbered compactly in the order of the file;
+	/// nodes which do not belong to a triangle are dropped. The boundary
+	/// edges get the first physical tag of the curve of the 2-node line on
+	/// them as tag (0 if there is none). Lines in the interior of the mesh
+	/// and other elements of dimension 0 and 1 are ignored.
+	void read_gmsh(const char* filename);
+
+	/// Write GRID to binary mesh file, see mesh_file.h for the format
+	/// @param[in] filename file to write to, will be overwritten
+	/// @param[in] with_boundary if true, boundary_flag_ and boundary_edges_
+	/// are stored as well
+	void write_binary(const char* filename, bool with_boundary = true) const;
+
+	/// Write GRID to the checkpoint file fp, i.e. coordinates,
+	/// connectivity, boundary_edges_, the edge table, refinement_info_ and
+	/// renumbered_
+	/// @return true on success
+	bool write_checkpoint(FILE *fp) const;
+
+	/// Read GRID from the checkpoint file fp, see write_checkpoint
+	/// @return false if fp does not contain a valid GRID
+	bool read_checkpoint(FILE *fp);
+
+	/// Read GRID from binary mesh file written by write_binary
+	/// The file is mapped into memory and its blocks are copied to the
+	/// GRID without any parsing. boundary_edges_ and boundary_flag_ are
+	/// taken from the file if they are contained there, otherwise they are
+	/// computed by init(). The edge table is not built; it is computed on
+	/// demand, e.g. by the first refinement, which also checks that the
+	/// boundary edges are edges of the triangles.
+	void read_binary(const char* filename);
+
 	/// Routine to uniformly refine the GRID and interpolate given FE_VECs on this GRID to new grid
 	/// \param[in] in FE_VECs to be interpolated
 	/// \param[in] num_vec number of inpute FE_VECs
 	/// \param[out] newgrid refined GRID
 	/// \param[out] out interpolated FE_VECs on newgrid
+	/// \param[in] num_threads number of threads; newgrid and out do not
+	/// depend on the number of threads
 	void refine_ip(
+		const FE_VEC in[],
+		int num_vec,
+		GRID &newgrid,
+		FE_VEC out[],
+		int num_threads = 1
+	);
+
+	/// Routine to uniformly refine the GRID and interpolate all fields of
+	/// a FE_MULTIVEC on this GRID to new grid in one pass
+	/// \param[in] in FE_MULTIVEC to be interpolated
+	/// \param[out] newgrid refined GRID
+	/// \param[out] out interpolated FE_MULTIVEC on newgrid
+	/// \param[in] num_threads number of threads
+	void refine_ip(
+		const FE_MULTIVEC &in,
+		GRID &newgrid,
+		FE_MULTIVEC &out,
+		int num_threads = 1
+	);
+
+	/// Routine to locally refine the GRID by newest vertex bisection and
+	/// interpolate given FE_VECs on this GRID to new grid
+	/// The refinement edge of a triangle is side 0, i.e. the edge opposite
+	/// to its newest vertex t[2]. A triangle is bisected by connecting the
+	/// newest vertex with the middle of the refinement edge; the children
+	/// are numbered such that the new node is their newest vertex again.
+	/// Further edges are bisected until the new grid is conforming.
+	/// Unmarked triangles which are not affected keep their vertices.
+	/// Bisected boundary edges are replaced by their two halves.
+	/// \param[in] marked marked[t] is true if triangle t has to be refined
+	/// \param[in] in FE_VECs to be interpolated
+	/// \param[in] num_vec number of inpute FE_VECs
+	/// \param[out] newgrid refined GRID
+	/// \param[out] out interpolated FE_VECs on newgrid
+	void refine_marked_ip(
+		const std::vector<bool> &marked,
 		const FE_VEC in[],
 		int num_vec,
 		GRID &newgrid,
 		FE_VEC out[]
 	);
 
+	/// Renumber nodes and triangles along a Hilbert space-filling curve
+	/// Nodes are ordered by the Hilbert index of their coordinates,
+	/// triangles by the Hilbert index of their centroids, such that
+	/// neighbouring nodes and triangles are close in memory.
+	/// The edge table and refinement_info_ of this GRID are dropped since
+	/// the edge numbers change, i.e. refine_dirichlet_bc cannot be used on
+	/// this GRID until it is refined again, and the GRID is marked as
+	/// renumbered, i.e. refine_dirichlet_bc cannot be used with this GRID
+	/// as finer GRID either; FE_VECs on this GRID have to be
+	/// renumbered with FE_VEC::permute(node_perm), and a coarser GRID
+	/// refined to this GRID with remap_refinement_info(node_perm)
+	/// \param[out] node_perm node_perm[i] is the new number of old node i
+	/// \param[out] tri_perm tri_perm[t] is the new number of old triangle t
+	/// \param[in] num_threads number of threads for computing the curve indices
+	void renumber_hilbert(
+		std::vector<index_t> &node_perm,
+		std::vector<index_t> &tri_perm,
+		int num_threads = 1
+	);
+
+	/// Adapt refinement_info_ to a renumbering of the nodes of the finer GRID
+	/// \param[in] fine_node_perm node permutation returned by renumber_hilbert
+	/// on the finer GRID
+	void remap_refinement_info(const std::vector<index_t> &fine_node_perm) {
+		for(std::size_t e = 0; e < refinement_info_.size(); ++e) {
+			if(refinement_info_[e] >= 0) {
+				refinement_info_[e] = fine_node_perm[refinement_info_[e]];
+			}
+		}
+	}
+
+	/// Check that refinement_info_ refers to nodes of finer, e.g. after a
+	/// checkpoint has been read
+	bool check_refinement_info(const GRID &finer) const {
+		for(std::size_t e = 0; e < refinement_info_.size(); ++e) {
+			if(refinement_info_[e] < -1 || refinement_info_[e] >= finer.num_nodes()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	/// Print out GRID
 	inline void print( void ) const
 	{
 		std::cout << "Points:" << std::endl;
-		for(int i = 0; i < static_cast<int>(coords_.size()); ++i) {
-			std::cout << "\t" << i << ": (" << coords_[i][0] << ", " << coords_[i][1] << ")" << std::endl;
+		for(index_t i = 0; i < num_nodes(); ++i) {
+			std::cout << "\t" << i << ": (" << coords_[0][i] << ", " << coords_[1][i] << ")" << std::endl;
 		}
 
 		std::cout << "Connectivity:" << std::endl;
-		for(int i = 0; i < static_cast<int>(conn_.size()); ++i) {
+		for(index_t i = 0; i < num_triangles(); ++i) {
 			std::cout << "\t" << i << ": (" << conn_[i][0] << ", " << conn_[i][1] << ", " << conn_[i][2] << ")" << std::endl;
 		}
 	}
 };
 
+/*****************************************************************************/
+/* Template implementations                                                  */
+/*****************************************************************************/
+
+template<class F>
+void GRID::evaluate(F evaluator, FE_VEC &vec, int num_threads) const {
+	const count_t n = num_nodes();
+	vec.resize(num_nodes());
+	double *values = vec.getValues().data();
+
+	const count_t num_blocks = (n + NODAL_BLOCK_SIZE - 1) / NODAL_BLOCK_SIZE;
+	parallel_for(count_t(0), num_blocks, num_threads, [&](count_t first, count_t last, int) {
+		const double *coords[NDIM];
+		for(count_t b = first; b < last; ++b) {
+			const count_t begin = b * NODAL_BLOCK_SIZE;
+			const count_t end = std::min(begin + NODAL_BLOCK_SIZE, n);
+			for(int d = 0; d < NDIM; ++d) {
+				coords[d] = coords_[d].data() + begin;
+			}
+			evaluator(end - begin, coords, values + begin);
+		}
+	});
+}
+
+template<class F>
+void GRID::compute_dirichlet_bc(F evaluator,
+                                std::vector<index_t> &dirichlet_nodes,
+                                std::vector<double> &dirichlet_val) {
+	const count_t n = boundary_nodes_.size();
+	const index_t *nodes = boundary_nodes_.data();
+
+	const double *coords[NDIM];
+	for(int d = 0; d < NDIM; ++d) {
+		boundary_coords_[d].resize(n);
+		const double *x = coords_[d].data();
+		double *bx = boundary_coords_[d].data();
+		for(count_t i = 0; i < n; ++i) {
+			bx[i] = x[nodes[i]];
+		}
+		coords[d] = bx;
+	}
+	boundary_values_.resize(n);
+	boundary_is_dirichlet_.resize(n);
+
+	evaluator(n, coords, boundary_values_.data(), boundary_is_dirichlet_.data());
+
+	dirichlet_nodes.clear();
+	dirichlet_val.clear();
+	for(count_t i = 0; i < n; ++i) {
+		if(boundary_is_dirichlet_[i]) {
+			dirichlet_nodes.push_back(nodes[i]);
+			dirichlet_val.push_back(boundary_values_[i]);
+		}
+	}
+}
+
+template<class F>
+void GRID::compute_dirichlet_bc(const std::vector<int> &tags,
+                                F evaluator,
+                                std::vector<index_t> &dirichlet_nodes,
+                                std::vector<double> &dirichlet_val) {
+	// nodes on edges with one of the tags; nodes at the junction of two
+	// tags are contained in both lists
+	dirichlet_nodes.clear();
+	for(std::size_t k = 0; k < tags.size(); ++k) {
+		count_t num;
+		const index_t *nodes = tagged_boundary_nodes(tags[k], num);
+		dirichlet_nodes.insert(dirichlet_nodes.end(), nodes, nodes + num);
+	}
+	if(tags.size() > 1) {
+		std::sort(dirichlet_nodes.begin(), dirichlet_nodes.end());
+		dirichlet_nodes.erase(std::unique(dirichlet_nodes.begin(), dirichlet_nodes.end()),
+		                      dirichlet_nodes.end());
+	}
+
+	const count_t n = dirichlet_nodes.size();
+	const index_t *nodes = dirichlet_nodes.data();
+
+	const double *coords[NDIM];
+	for(int d = 0; d < NDIM; ++d) {
+		boundary_coords_[d].resize(n);
+		const double *x = coords_[d].data();
+		double *bx = boundary_coords_[d].data();
+		for(count_t i = 0; i < n; ++i) {
+			bx[i] = x[nodes[i]];
+		}
+		coords[d] = bx;
+	}
+	dirichlet_val.resize(n);
+
+	evaluator(n, coords, dirichlet_val.data());
+}
+
+template<class F>
+bool GRID::refine_dirichlet_bc(const std::vector<int> &tags,
+                               F evaluator,
+                               GRID &finer,
+                               std::vector<index_t> &dirichlet_nodes,
+                               std::vector<double> &dirichlet_val) const {
+	assert(dirichlet_nodes.size() == dirichlet_val.size());
+	if(refinement_info_.size() != static_cast<std::size_t>(num_edges()) || tri_edges_.empty()
+	   || finer.num_nodes() < num_nodes() || finer.renumbered_) {
+		std::cout << "refine_dirichlet_bc needs the refinement information of the last refinement; the GRID has not been refined or one of the GRIDs has been renumbered since." << std::endl;
+		return false;
+	}
+
+	// new nodes on the refined Dirichlet edges; they are numbered after the
+	// nodes of this GRID, i.e. after all old Dirichlet nodes
+	const std::size_t num_old = dirichlet_nodes.size();
+	for(std::size_t i = 0; i < boundary_edges_.size(); ++i) {
+		const BoundaryEdge &edge = boundary_edges_[i];
+		if(std::find(tags.begin(), tags.end(), edge.tag_) == tags.end()) {
+			continue;
+		}
+		const index_t e = find_edge(edge.nodes_[0], edge.nodes_[1]);
+		const index_t m = e >= 0 ? refinement_info_[e] : -1;
+		if(e < 0 || (m >= 0 && (m < num_nodes() || m >= finer.num_nodes()))) {
+			std::cout << "refine_dirichlet_bc: the refinement information does not fit the boundary edges." << std::endl;
+			dirichlet_nodes.resize(num_old);
+			return false;
+		}
+		if(m >= 0) {
+			dirichlet_nodes.push_back(m);
+		}
+	}
+	std::sort(dirichlet_nodes.begin() + num_old, dirichlet_nodes.end());
+
+	const count_t n = dirichlet_nodes.size() - num_old;
+	const index_t *nodes = dirichlet_nodes.data() + num_old;
+
+	const double *coords[NDIM];
+	for(int d = 0; d < NDIM; ++d) {
+		finer.boundary_coords_[d].resize(n);
+		const double *x = finer.coords_[d].data();
+		double *bx = finer.boundary_coords_[d].data();
+		for(count_t i = 0; i < n; ++i) {
+			bx[i] = x[nodes[i]];
+		}
+		coords[d] = bx;
+	}
+	dirichlet_val.resize(num_old + n);
+
+	evaluator(n, coords, dirichlet_val.data() + num_old);
+	return true;
+}
+
 /*****************************************************************************/
 /* Functions                                                                 */
 /*****************************************************************************/
 
+/// Encoding of the DataArrays in vtu files
+enum VtuFormat {
+	/// Human readable text, values are rounded to 6 decimals
+	VTU_ASCII,
+	/// Raw binary data in an AppendedData section, one block per DataArray
+	VTU_APPENDED_RAW,
+	/// Like VTU_APPENDED_RAW, but each DataArray is split into blocks
+	/// which are compressed with zlib
+	VTU_APPENDED_ZLIB,
+	/// Like VTU_APPENDED_ZLIB, but with LZ4 compression (faster, larger
+	/// files); only available if compiled with -DHAVE_LZ4
+	VTU_APPENDED_LZ4
+};
+
+/// Type of the floating point DataArrays in vtu files
+enum VtuPrecision {
+	/// Float64, i.e. the values as they are stored
+	VTU_FLOAT64,
+	/// Float32 for coordinates and point data; connectivity and offsets
+	/// are written as Int32 as well if the numbers fit. Only used for the
+	/// appended formats.
+	VTU_FLOAT32
+};
+
+/// @brief Options for write_vtu and write_pvd
+struct VtuOptions {
+	/// Encoding of the DataArrays
+	VtuFormat format_;
+
+	/// Number of pieces for write_pvd; if larger than 1, write_pvd writes
+	/// a pvtu file and the pieces concurrently, see write_pvtu
+	int num_pieces_;
+
+	/// Number of threads for compressing the blocks of a DataArray
+	int num_threads_;
+
+	/// zlib compression level from 1 (fastest, default) to 9 (smallest files)
+	int compression_level_;
+
+	/// Type of coordinates and point data in the appended formats
+	VtuPrecision precision_;
+
+	/// If positive, the point data are written lossy in the appended
+	/// formats: each value is rounded to as few mantissa bits as possible
+	/// such that the absolute error is at most quantization_tolerance_ (in
+	/// addition to the rounding to Float32). The cleared trailing bits make
+	/// compressed files much smaller. 0 (default) writes the exact values.
+	double quantization_tolerance_;
+
+	VtuOptions(VtuFormat format = VTU_ASCII, int num_pieces = 1, int num_threads = 1)
+		: format_(format), num_pieces_(num_pieces), num_threads_(num_threads), compression_level_(1),
+		  precision_(VTU_FLOAT64), quantization_tolerance_(0.0) {}
+};
+
 /// Write out FE_VECs on GRID to vtu file for visualization (use e.g. ParaView to view these files)
 /// @param g GRID on which the FE_VECs are defined
 /// @param vectors FE_VECs which data shall be visualized
 /// @param n_vectors length of vectors
 /// @param name filename for the output
+/// @param options output options, e.g. ascii or binary
 int write_vtu( 			// Function to write a grid to a .vtu-file for Paraview
 	GRID &g,		// a grid
 	FE_VEC vectors[],	// a list of fe vectors
 	int n_vectors,		// number of fe vectors to write
-	char* name				// filename to write to, will overwrite w/o warning
+	char* name,				// filename to write to, will overwrite w/o warning
+	const VtuOptions &options = VtuOptions()
+);
+
+/// Write out FE_VECs on GRID to a pvtu file and options.num_pieces_ vtu
+/// files for the pieces, which are written concurrently by one thread each
+/// Piece p contains the p-th of options.num_pieces_ contiguous blocks of
+/// triangles together with the nodes of these triangles.
+/// @param g GRID on which the FE_VECs are defined
+/// @param vectors FE_VECs which data shall be visualized
+/// @param n_vectors length of vectors
+/// @param name filename of the pvtu file, has to end with ".pvtu"; the
+/// pieces are written to the files name_<p>.vtu without the ".pvtu"
+/// @param options output options, e.g. number of pieces
+int write_pvtu(
+	GRID &g,
+	FE_VEC vectors[],
+	int n_vectors,
+	char* name,
+	const VtuOptions &options
 );
 
 /// Write out FE_VECs on GRID as one time-step of a time series via a pvd file (use e.g. ParaView to view this file)
@@ -231,13 +877,15 @@ int write_vtu( 			// Function to write a grid to a .vtu-file for Paraview
 /// @param prefix prefix for filenames of pvd and vtu files
 /// @param timestep number of the time-step to be visualized
 /// @param time (physical/simulated) time of the time-step
+/// @param options output options of the vtu file, see write_vtu
 int write_pvd(		// for problems that change over time this is useful:
 	GRID &g,					// grid
 	FE_VEC u[], 		// fe vectors
 	int n_vectors,	// no of fe vectors
 	char* prefix,		// prefix for filenames
 	int	timestep,		// number of timestep
-	double time			// current time
+	double time,			// current time
+	const VtuOptions &options = VtuOptions()
 );
 
 #endif
@@ -0,0 +1,357 @@
+/// Binary mesh file (see mesh_file.h) and checkpoint input and output of GRID
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <limits>
+#include "grid.h"
+#include "mesh_file.h"
+#include "io_util.h"
+
+/// Write size bytes at the current position of fp and pad with zeros up
+/// to the next block boundary
+static bool write_block(FILE *fp, const void *data, uint64_t size) {
+	static const char zeros[MESH_FILE_BLOCK_ALIGNMENT] = {0};
+	if(size > 0 && fwrite(data, 1, size, fp) != size) {
+		return false;
+	}
+	const uint64_t pad = mesh_file_align(size) - size;
+	return pad == 0 || fwrite(zeros, 1, pad, fp) == pad;
+}
+
+/// Check if the block [offset, offset+size) lies within the file
+static bool block_in_file(uint64_t offset, uint64_t size, uint64_t file_size) {
+	return offset <= file_size && size <= file_size - offset;
+}
+
+void GRID::write_binary(const char* filename, bool with_boundary) const {
+
+	const uint64_t nn = num_nodes();
+	const uint64_t nt = num_triangles();
+
+	const uint64_t nb = boundary_edges_.size();
+
+	// Triangle consists of NODES_PER_TRIANGLE index_t only, i.e. conn_ has
+	// the layout of the connectivity block
+	const MeshFileHeader header = mesh_file_header(NDIM, nn, nt, sizeof(index_t), with_boundary, nb);
+
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL) {
+		std::cout << "Could not open " << filename << " for writing." << std::endl;
+		exit(-1);
+	}
+
+	bool ok = write_block(fp, &header, sizeof(header));
+	for(int d = 0; d < NDIM; ++d) {
+		ok = ok && write_block(fp, coords_[d].data(), nn * sizeof(double));
+	}
+	ok = ok && write_block(fp, conn_.data(), nt * sizeof(Triangle));
+	if(with_boundary) {
+		std::vector<unsigned char> flags(nn);
+		for(uint64_t i = 0; i < nn; ++i) {
+			flags[i] = boundary_flag_[i];
+		}
+		ok = ok && write_block(fp, flags.data(), nn);
+
+		std::vector<index_t> edge_nodes(2 * nb);
+		std::vector<int32_t> tags(nb);
+		for(uint64_t i = 0; i < nb; ++i) {
+			edge_nodes[2 * i] = boundary_edges_[i].nodes_[0];
+			edge_nodes[2 * i + 1] = boundary_edges_[i].nodes_[1];
+			tags[i] = boundary_edges_[i].tag_;
+		}
+		ok = ok && write_block(fp, edge_nodes.data(), 2 * nb * sizeof(index_t));
+		ok = ok && write_block(fp, tags.data(), nb * sizeof(int32_t));
+	}
+
+	if(fclose(fp) != 0 || !ok) {
+		std::cout << "Error while writing " << filename << "." << std::endl;
+		exit(-1);
+	}
+}
+
+void GRID::read_binary(const char* filename) {
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		std::cout << "Could not open " << filename << " for reading." << std::endl;
+		exit(-1);
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(MeshFileHeader)) {
+		std::cout << filename << " is not a mesh file." << std::endl;
+		exit(-1);
+	}
+	const uint64_t file_size = st.st_size;
+
+	void *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		std::cout << "Could not map " << filename << " into memory." << std::endl;
+		exit(-1);
+	}
+	// every block is read exactly once from front to back
+	madvise(map, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+	const char *base = static_cast<const char*>(map);
+
+	MeshFileHeader header;
+	memcpy(&header, base, sizeof(header));
+
+	if(memcmp(header.magic_, MESH_FILE_MAGIC, sizeof(header.magic_)) != 0) {
+		std::cout << filename << " is not a mesh file." << std::endl;
+		exit(-1);
+	}
+	if(header.version_ < 1 || header.version_ > MESH_FILE_VERSION) {
+		std::cout << filename << " has unsupported version " << header.version_ << "." << std::endl;
+		exit(-1);
+	}
+	if(header.byte_order_ != MESH_FILE_BYTE_ORDER) {
+		std::cout << filename << " has been written on a machine with different byte order." << std::endl;
+		exit(-1);
+	}
+	if(header.ndim_ != NDIM || (header.index_size_ != 4 && header.index_size_ != 8)) {
+		std::cout << filename << " has dimension " << header.ndim_ << " and index size " << header.index_size_
+		          << ", expected dimension " << NDIM << " and index size 4 or 8." << std::endl;
+		exit(-1);
+	}
+
+	const uint64_t nn = header.num_nodes_;
+	const uint64_t nt = header.num_triangles_;
+	const bool with_boundary = (header.flags_ & MESH_FILE_HAS_BOUNDARY) != 0;
+	const bool with_edges = header.version_ >= 2 && (header.flags_ & MESH_FILE_HAS_BOUNDARY_EDGES) != 0;
+	const uint64_t nb = with_edges ? header.num_boundary_edges_ : 0;
+	if(nn > static_cast<uint64_t>(std::numeric_limits<index_t>::max())
+	   || nt > static_cast<uint64_t>(std::numeric_limits<index_t>::max())) {
+		std::cout << filename << " has " << nn << " nodes and " << nt << " triangles, which is too many for index_t." << std::endl;
+		exit(-1);
+	}
+
+	bool ok = header.file_size_ == file_size;
+	for(int d = 0; d < NDIM; ++d) {
+		ok = ok && block_in_file(header.coords_offset_[d], nn * sizeof(double), file_size);
+	}
+	ok = ok && block_in_file(header.conn_offset_, nt * NODES_PER_TRIANGLE * header.index_size_, file_size);
+	ok = ok && (!with_boundary || block_in_file(header.boundary_offset_, nn, file_size));
+	ok = ok && nb <= file_size;
+	ok = ok && (!with_edges || block_in_file(header.boundary_edges_offset_, 2 * nb * header.index_size_, file_size));
+	ok = ok && (!with_edges || block_in_file(header.boundary_tags_offset_, nb * sizeof(int32_t), file_size));
+	if(!ok) {
+		std::cout << filename << " is truncated or corrupt." << std::endl;
+		exit(-1);
+	}
+
+	// copy blocks; the only work per entry is the copy itself
+	for(int d = 0; d < NDIM; ++d) {
+		const double *src = reinterpret_cast<const double*>(base + header.coords_offset_[d]);
+		coords_[d].assign(src, src + nn);
+	}
+
+	if(header.index_size_ == sizeof(index_t)) {
+		const Triangle *src = reinterpret_cast<const Triangle*>(base + header.conn_offset_);
+		conn_.assign(src, src + nt);
+	} else {
+		// file has been written with different index_t
+		conn_.resize(nt);
+		const char *src = base + header.conn_offset_;
+		for(uint64_t t = 0; t < nt; ++t) {
+			for(int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+				int64_t v;
+				if(header.index_size_ == 4) {
+					int32_t v32;
+					memcpy(&v32, src + (NODES_PER_TRIANGLE * t + j) * 4, 4);
+					v = v32;
+				} else {
+					memcpy(&v, src + (NODES_PER_TRIANGLE * t + j) * 8, 8);
+				}
+				// out of range numbers are caught by the check below
+				conn_[t][j] = (v >= 0 && static_cast<uint64_t>(v) < nn) ? static_cast<index_t>(v) : -1;
+			}
+		}
+	}
+
+	for(uint64_t t = 0; t < nt && ok; ++t) {
+		for(int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+			ok = ok && conn_[t][j] >= 0 && static_cast<uint64_t>(conn_[t][j]) < nn;
+		}
+	}
+	if(!ok) {
+		std::cout << filename << " contains invalid vertex numbers." << std::endl;
+		exit(-1);
+	}
+
+	boundary_edges_.resize(nb);
+	for(uint64_t i = 0; i < nb; ++i) {
+		const char *src = base + header.boundary_edges_offset_ + 2 * i * header.index_size_;
+		for(int j = 0; j < 2; ++j) {
+			int64_t v;
+			if(header.index_size_ == 4) {
+				int32_t v32;
+				memcpy(&v32, src + j * 4, 4);
+				v = v32;
+			} else {
+				memcpy(&v, src + j * 8, 8);
+			}
+			ok = ok && v >= 0 && static_cast<uint64_t>(v) < nn;
+			boundary_edges_[i].nodes_[j] = static_cast<index_t>(v);
+		}
+		int32_t tag;
+		memcpy(&tag, base + header.boundary_tags_offset_ + i * sizeof(int32_t), sizeof(int32_t));
+		boundary_edges_[i].tag_ = tag;
+	}
+	if(!ok) {
+		std::cout << filename << " contains invalid boundary edges." << std::endl;
+		exit(-1);
+	}
+
+	// boundary flags as stored; they are derived from the boundary edges
+	// by the writer
+	if(with_boundary) {
+		const unsigned char *src = reinterpret_cast<const unsigned char*>(base + header.boundary_offset_);
+		boundary_flag_.assign(src, src + nn);
+	}
+
+	munmap(map, file_size);
+
+	// drop data of a previously stored GRID
+	clear_edge_table();
+	renumbered_ = false;
+
+	// files without boundary edges, e.g. of version 1, get them from the
+	// edge adjacency. The boundary edges are only range checked here; that
+	// they are edges of the triangles is checked when the edge table is
+	// built, see check_boundary_edges.
+	if(with_edges && with_boundary) {
+		compute_boundary_index();
+	} else if(with_edges) {
+		compute_boundary_flag();
+	} else {
+		init();
+	}
+}
+
+bool GRID::check_boundary_edges() {
+	if(static_cast<count_t>(tri_edges_.size()) != static_cast<count_t>(NODES_PER_TRIANGLE) * num_triangles()) {
+		compute_edge_table();
+	}
+	for(size_t i = 0; i < boundary_edges_.size(); ++i) {
+		if(find_edge(boundary_edges_[i].nodes_[0], boundary_edges_[i].nodes_[1]) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool GRID::write_checkpoint(FILE *fp) const {
+	bool ok = true;
+	for(int d = 0; d < NDIM; ++d) {
+		ok = ok && write_array(fp, coords_[d]);
+	}
+	ok = ok && write_array(fp, conn_);
+	ok = ok && write_array(fp, boundary_edges_);
+	ok = ok && write_array(fp, refinement_info_);
+	ok = ok && write_array(fp, edge_ptr_);
+	ok = ok && write_array(fp, edge_target_);
+	ok = ok && write_array(fp, edge_index_);
+	ok = ok && write_array(fp, tri_edges_);
+	ok = ok && write_array(fp, edge_nodes_);
+	const unsigned char renumbered = renumbered_;
+	ok = ok && fwrite(&renumbered, 1, 1, fp) == 1;
+	return ok;
+}
+
+bool GRID::read_checkpoint(FILE *fp) {
+	bool ok = true;
+	for(int d = 0; d < NDIM; ++d) {
+		ok = ok && read_array(fp, coords_[d]);
+	}
+	ok = ok && read_array(fp, conn_);
+	ok = ok && read_array(fp, boundary_edges_);
+	ok = ok && read_array(fp, refinement_info_);
+	ok = ok && read_array(fp, edge_ptr_);
+	ok = ok && read_array(fp, edge_target_);
+	ok = ok && read_array(fp, edge_index_);
+	ok = ok && read_array(fp, tri_edges_);
+	ok = ok && read_array(fp, edge_nodes_);
+	unsigned char renumbered = 0;
+	ok = ok && fread(&renumbered, 1, 1, fp) == 1 && renumbered <= 1;
+	renumbered_ = renumbered == 1;
+	if(!ok) {
+		return false;
+	}
+
+	// consistency of the sizes; the edge table is either complete or empty
+	const uint64_t nn = coords_[0].size();
+	const uint64_t nt = conn_.size();
+	for(int d = 1; d < NDIM; ++d) {
+		ok = ok && coords_[d].size() == nn;
+	}
+	ok = ok && nn <= static_cast<uint64_t>(std::numeric_limits<index_t>::max());
+	ok = ok && nt <= static_cast<uint64_t>(std::numeric_limits<index_t>::max());
+	if(!edge_nodes_.empty() || !tri_edges_.empty()) {
+		ok = ok && edge_ptr_.size() == nn + 1;
+		ok = ok && edge_target_.size() * 2 == edge_nodes_.size();
+		ok = ok && edge_index_.size() * 2 == edge_nodes_.size();
+		ok = ok && tri_edges_.size() == NODES_PER_TRIANGLE * nt;
+	}
+	ok = ok && (refinement_info_.empty() || refinement_info_.size() * 2 == edge_nodes_.size());
+	for(uint64_t t = 0; t < nt && ok; ++t) {
+		for(int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+			ok = ok && conn_[t][j] >= 0 && static_cast<uint64_t>(conn_[t][j]) < nn;
+		}
+	}
+	for(uint64_t i = 0; i < boundary_edges_.size() && ok; ++i) {
+		for(int j = 0; j < 2; ++j) {
+			ok = ok && boundary_edges_[i].nodes_[j] >= 0 && static_cast<uint64_t>(boundary_edges_[i].nodes_[j]) < nn;
+		}
+	}
+	if(!ok) {
+		return false;
+	}
+
+	// contents of the edge table: edge_ptr_ is monotone, all node and edge
+	// numbers are in range and the rows, edge_nodes_ and tri_edges_ describe
+	// the same edges, i.e. find_edge, edge_node and get_triangle_edge are
+	// consistent with conn_
+	const uint64_t ne = edge_nodes_.size() / 2;
+	if(!edge_nodes_.empty() || !tri_edges_.empty()) {
+		ok = ok && edge_ptr_[0] == 0 && static_cast<uint64_t>(edge_ptr_[nn]) == ne;
+		for(uint64_t v = 0; v < nn && ok; ++v) {
+			ok = ok && edge_ptr_[v] <= edge_ptr_[v+1];
+		}
+		for(uint64_t i = 0; i < 2 * ne && ok; ++i) {
+			ok = ok && edge_nodes_[i] >= 0 && static_cast<uint64_t>(edge_nodes_[i]) < nn;
+		}
+		for(uint64_t v = 0; v < nn && ok; ++v) {
+			for(index_t k = edge_ptr_[v]; k < edge_ptr_[v+1] && ok; ++k) {
+				const index_t w = edge_target_[k];
+				const index_t e = edge_index_[k];
+				ok = ok && w > static_cast<index_t>(v) && static_cast<uint64_t>(w) < nn;
+				ok = ok && e >= 0 && static_cast<uint64_t>(e) < ne;
+				ok = ok && std::min(edge_nodes_[2*e], edge_nodes_[2*e+1]) == static_cast<index_t>(v)
+				        && std::max(edge_nodes_[2*e], edge_nodes_[2*e+1]) == w;
+			}
+		}
+		for(uint64_t t = 0; t < nt && ok; ++t) {
+			for(int s = 0; s < NODES_PER_TRIANGLE && ok; ++s) {
+				const index_t e = tri_edges_[NODES_PER_TRIANGLE * t + s];
+				ok = ok && e >= 0 && static_cast<uint64_t>(e) < ne;
+				ok = ok && find_edge(conn_[t][s], conn_[t][(s+1) % NODES_PER_TRIANGLE]) == e;
+			}
+		}
+	}
+	for(uint64_t e = 0; e < refinement_info_.size() && ok; ++e) {
+		ok = ok && refinement_info_[e] >= -1;
+	}
+	// without edge table, the boundary edges are checked when it is built
+	// (see read_binary), i.e. the GRID is restored as it was written
+	if(!ok || (!tri_edges_.empty() && !check_boundary_edges())) {
+		return false;
+	}
+
+	compute_boundary_flag();
+	return true;
+}
@@ -0,0 +1,387 @@
+/// Input of Gmsh meshes in binary MSH 4.1 format
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include "grid.h"
+
+// Gmsh element types used here
+static const int GMSH_LINE = 1;
+static const int GMSH_TRIANGLE = 2;
+
+// Number of nodes of Gmsh element type, 0 for unknown types
+static int gmsh_nodes_per_element(int type) {
+	static const int nodes[] = {
+		0, 2, 3, 4, 4, 8, 6, 5, 3, 6, 9, 10, 27, 18, 14, 1, 8, 20, 15, 13,
+		9, 10, 12, 15, 15, 21, 4, 5, 6, 20, 35, 56
+	};
+	return (type >= 0 && type < static_cast<int>(sizeof(nodes) / sizeof(nodes[0]))) ? nodes[type] : 0;
+}
+
+// Dimension of Gmsh element type
+static int gmsh_element_dim(int type) {
+	switch(type) {
+	case 15:
+		return 0;
+	case 1: case 8: case 26: case 27: case 28:
+		return 1;
+	case 2: case 3: case 9: case 10: case 16: case 20: case 21: case 22: case 23: case 24: case 25:
+		return 2;
+	default:
+		return 3;
+	}
+}
+
+// Sequential reader for the memory mapped file; all read functions
+// return false at the end of the file
+struct GmshReader {
+	const char *pos;
+	const char *end;
+
+	template<class T>
+	bool read(T &value) {
+		if(end - pos < static_cast<long>(sizeof(T))) {
+			return false;
+		}
+		memcpy(&value, pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	// Pointer to n values of type T at the current position
+	template<class T>
+	const char* skip(uint64_t n) {
+		if(static_cast<uint64_t>(end - pos) / sizeof(T) < n) {
+			return NULL;
+		}
+		const char *p = pos;
+		pos += n * sizeof(T);
+		return p;
+	}
+
+	// Read the rest of the current line without the newline
+	bool read_line(std::string &line) {
+		const char *nl = static_cast<const char*>(memchr(pos, '\n', end - pos));
+		if(nl == NULL) {
+			return false;
+		}
+		line.assign(pos, nl);
+		if(!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		pos = nl + 1;
+		return true;
+	}
+
+	// Skip to the line after "$End<section>"
+	bool skip_section(const std::string &section) {
+		const std::string marker = "$End" + section;
+		std::string line;
+		while(read_line(line)) {
+			if(line == marker) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// Exit with error message
+static void gmsh_error(const char* filename, const char* message) {
+	std::cout << "Error reading " << filename << ": " << message << std::endl;
+	exit(-1);
+}
+
+void GRID::read_gmsh(const char* filename) {
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		std::cout << "Could not open " << filename << " for reading." << std::endl;
+		exit(-1);
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		gmsh_error(filename, "empty file");
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		std::cout << "Could not map " << filename << " into memory." << std::endl;
+		exit(-1);
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+	GmshReader in;
+	in.pos = static_cast<const char*>(map);
+	in.end = in.pos + st.st_size;
+
+	// physical tag of the curves, first physical tag if there are several
+	std::map<int, int> curve_tag;
+
+	// nodes in the order of the file
+	std::vector<uint64_t> node_tags;
+	std::vector<double> node_coords[NDIM];
+
+	// triangles and lines with Gmsh node tags
+	std::vector<uint64_t> tri_nodes;
+	std::vector<uint64_t> line_nodes;
+	std::vector<int> line_entity;
+
+	bool have_format = false, have_nodes = false, have_elements = false;
+	std::string line;
+	while(in.read_line(line)) {
+		if(line.empty()) {
+			continue;
+		}
+		if(line[0] != '$') {
+			gmsh_error(filename, "section expected");
+		}
+		const std::string section = line.substr(1);
+
+		if(section == "MeshFormat") {
+			double version;
+			int file_type, data_size;
+			int one;
+			if(!in.read_line(line) || sscanf(line.c_str(), "%lf %d %d", &version, &file_type, &data_size) != 3) {
+				gmsh_error(filename, "invalid $MeshFormat");
+			}
+			if(version < 4.1 || version >= 5.0 || file_type != 1 || data_size != sizeof(uint64_t)) {
+				gmsh_error(filename, "only binary MSH 4.1 files with 8 byte size_t are supported");
+			}
+			if(!in.read(one) || one != 1) {
+				gmsh_error(filename, "file has been written on a machine with different byte order");
+			}
+			have_format = true;
+		} else if(section == "Entities") {
+			uint64_t num[4];
+			for(int d = 0; d < 4; ++d) {
+				if(!in.read(num[d])) {
+					gmsh_error(filename, "invalid $Entities");
+				}
+			}
+			for(int d = 0; d < 4; ++d) {
+				for(uint64_t e = 0; e < num[d]; ++e) {
+					int tag;
+					uint64_t num_physical, num_bounding;
+					// points have 3 coordinates, other entities a bounding box
+					bool ok = in.read(tag) && in.skip<double>(d == 0 ? 3 : 6) != NULL && in.read(num_physical);
+					const char *physical = ok ? in.skip<int>(num_physical) : NULL;
+					ok = physical != NULL;
+					if(ok && d > 0) {
+						ok = in.read(num_bounding) && in.skip<int>(num_bounding) != NULL;
+					}
+					if(!ok) {
+						gmsh_error(filename, "invalid $Entities");
+					}
+					if(d == 1) {
+						int first = 0;
+						if(num_physical > 0) {
+							memcpy(&first, physical, sizeof(int));
+						}
+						curve_tag[tag] = first;
+					}
+				}
+			}
+		} else if(section == "Nodes") {
+			uint64_t num_blocks, num_nodes, min_tag, max_tag;
+			if(!in.read(num_blocks) || !in.read(num_nodes) || !in.read(min_tag) || !in.read(max_tag)
+			   || num_nodes > static_cast<uint64_t>(in.end - in.pos)) {
+				gmsh_error(filename, "invalid $Nodes");
+			}
+			node_tags.reserve(num_nodes);
+			for(int d = 0; d < NDIM; ++d) {
+				node_coords[d].reserve(num_nodes);
+			}
+			for(uint64_t b = 0; b < num_blocks; ++b) {
+				int dim, entity, parametric;
+				uint64_t n;
+				if(!in.read(dim) || !in.read(entity) || !in.read(parametric) || !in.read(n)) {
+					gmsh_error(filename, "invalid $Nodes");
+				}
+				// x, y, z and the parametric coordinates
+				const int values = 3 + (parametric ? dim : 0);
+				const char *tags = in.skip<uint64_t>(n);
+				const char *xyz = tags ? in.skip<double>(n * values) : NULL;
+				if(xyz == NULL) {
+					gmsh_error(filename, "invalid $Nodes");
+				}
+				const size_t first = node_tags.size();
+				node_tags.resize(first + n);
+				memcpy(&node_tags[first], tags, n * sizeof(uint64_t));
+				for(uint64_t i = 0; i < n; ++i) {
+					for(int d = 0; d < NDIM; ++d) {
+						double x;
+						memcpy(&x, xyz + (i * values + d) * sizeof(double), sizeof(double));
+						node_coords[d].push_back(x);
+					}
+				}
+			}
+			have_nodes = true;
+		} else if(section == "Elements") {
+			uint64_t num_blocks, num_elements, min_tag, max_tag;
+			if(!in.read(num_blocks) || !in.read(num_elements) || !in.read(min_tag) || !in.read(max_tag)) {
+				gmsh_error(filename, "invalid $Elements");
+			}
+			for(uint64_t b = 0; b < num_blocks; ++b) {
+				int dim, entity, type;
+				uint64_t n;
+				if(!in.read(dim) || !in.read(entity) || !in.read(type) || !in.read(n)) {
+					gmsh_error(filename, "invalid $Elements");
+				}
+				const int nodes = gmsh_nodes_per_element(type);
+				if(nodes == 0) {
+					gmsh_error(filename, "unknown element type");
+				}
+				// element tag followed by the node tags
+				const char *data = in.skip<uint64_t>(n * (1 + nodes));
+				if(data == NULL) {
+					gmsh_error(filename, "invalid $Elements");
+				}
+				std::vector<uint64_t> *target = NULL;
+				if(type == GMSH_TRIANGLE) {
+					target = &tri_nodes;
+				} else if(type == GMSH_LINE) {
+					target = &line_nodes;
+					line_entity.insert(line_entity.end(), n, entity);
+				} else if(gmsh_element_dim(type) >= 2) {
+					gmsh_error(filename, "only 3-node triangles are supported as elements of dimension 2 and 3");
+				}
+				if(target != NULL) {
+					const size_t first = target->size();
+					target->resize(first + n * nodes);
+					for(uint64_t i = 0; i < n; ++i) {
+						memcpy(&(*target)[first + i * nodes], data + (i * (1 + nodes) + 1) * sizeof(uint64_t),
+						       nodes * sizeof(uint64_t));
+					}
+				}
+			}
+			have_elements = true;
+		}
+
+		if(!in.skip_section(section)) {
+			gmsh_error(filename, ("missing $End" + section).c_str());
+		}
+	}
+	munmap(map, st.st_size);
+
+	if(!have_format || !have_nodes || !have_elements) {
+		gmsh_error(filename, "$MeshFormat, $Nodes or $Elements missing");
+	}
+
+	// position of the nodes in the file by tag; Gmsh usually numbers the
+	// nodes (almost) contiguously, then a direct lookup table is used,
+	// otherwise a sorted list of (tag, position)
+	uint64_t min_tag = std::numeric_limits<uint64_t>::max(), max_tag = 0;
+	for(size_t i = 0; i < node_tags.size(); ++i) {
+		min_tag = std::min(min_tag, node_tags[i]);
+		max_tag = std::max(max_tag, node_tags[i]);
+	}
+	const bool dense = !node_tags.empty() && max_tag - min_tag < 4 * node_tags.size();
+	std::vector<int64_t> pos_of_tag;
+	std::vector<std::pair<uint64_t, uint64_t> > by_tag;
+	if(dense) {
+		pos_of_tag.assign(max_tag - min_tag + 1, -1);
+		for(size_t i = 0; i < node_tags.size(); ++i) {
+			pos_of_tag[node_tags[i] - min_tag] = i;
+		}
+	} else {
+		by_tag.resize(node_tags.size());
+		for(size_t i = 0; i < node_tags.size(); ++i) {
+			by_tag[i] = std::make_pair(node_tags[i], i);
+		}
+		std::sort(by_tag.begin(), by_tag.end());
+	}
+	// position of node tag, or -1 if there is no such node
+	auto find_node = [&](uint64_t tag) -> int64_t {
+		if(dense) {
+			return (tag >= min_tag && tag <= max_tag) ? pos_of_tag[tag - min_tag] : -1;
+		}
+		std::vector<std::pair<uint64_t, uint64_t> >::const_iterator it =
+			std::lower_bound(by_tag.begin(), by_tag.end(), std::make_pair(tag, uint64_t(0)));
+		return (it != by_tag.end() && it->first == tag) ? static_cast<int64_t>(it->second) : -1;
+	};
+
+	// compact numbering of the nodes of the triangles in the order of the file
+	std::vector<int64_t> tri_pos(tri_nodes.size());
+	std::vector<int64_t> new_number(node_tags.size(), -1);
+	for(size_t k = 0; k < tri_nodes.size(); ++k) {
+		tri_pos[k] = find_node(tri_nodes[k]);
+		if(tri_pos[k] < 0) {
+			gmsh_error(filename, "triangle with undefined node");
+		}
+		new_number[tri_pos[k]] = 0;
+	}
+	int64_t nn = 0;
+	for(size_t i = 0; i < new_number.size(); ++i) {
+		if(new_number[i] == 0) {
+			new_number[i] = nn++;
+		}
+	}
+	const uint64_t nt = tri_nodes.size() / NODES_PER_TRIANGLE;
+	if(nn > std::numeric_limits<index_t>::max() || nt > static_cast<uint64_t>(std::numeric_limits<index_t>::max())) {
+		gmsh_error(filename, "too many nodes or triangles for index_t");
+	}
+
+	for(int d = 0; d < NDIM; ++d) {
+		coords_[d].resize(nn);
+	}
+	for(size_t i = 0; i < new_number.size(); ++i) {
+		if(new_number[i] >= 0) {
+			for(int d = 0; d < NDIM; ++d) {
+				coords_[d][new_number[i]] = node_coords[d][i];
+			}
+		}
+	}
+
+	// vertices of triangles are numbered counter-clockwise in GRID
+	conn_.resize(nt);
+	const double *x = coords_[0].data();
+	const double *y = coords_[1].data();
+	for(uint64_t t = 0; t < nt; ++t) {
+		Triangle &tri = conn_[t];
+		for(int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+			tri[j] = new_number[tri_pos[NODES_PER_TRIANGLE * t + j]];
+		}
+		const double area2 = (x[tri[1]] - x[tri[0]]) * (y[tri[2]] - y[tri[0]])
+		                   - (x[tri[2]] - x[tri[0]]) * (y[tri[1]] - y[tri[0]]);
+		if(area2 < 0) {
+			std::swap(tri[1], tri[2]);
+		}
+	}
+
+	// drop data of a previously stored GRID
+	clear_edge_table();
+	renumbered_ = false;
+
+	init();
+
+	// tags of the lines on boundary edges; lines which are no edge of the
+	// GRID or in its interior are ignored
+	std::vector<int> edge_tag(num_edges(), 0);
+	for(size_t l = 0; l < line_entity.size(); ++l) {
+		index_t nodes[2];
+		bool ok = true;
+		for(int j = 0; j < 2; ++j) {
+			const int64_t pos = find_node(line_nodes[2 * l + j]);
+			ok = ok && pos >= 0 && new_number[pos] >= 0;
+			nodes[j] = ok ? new_number[pos] : -1;
+		}
+		const index_t e = ok ? find_edge(nodes[0], nodes[1]) : -1;
+		if(e >= 0) {
+			std::map<int, int>::const_iterator it = curve_tag.find(line_entity[l]);
+			edge_tag[e] = it != curve_tag.end() ? it->second : 0;
+		}
+	}
+	for(size_t i = 0; i < boundary_edges_.size(); ++i) {
+		boundary_edges_[i].tag_ = edge_tag[find_edge(boundary_edges_[i].nodes_[0], boundary_edges_[i].nodes_[1])];
+	}
+	compute_boundary_flag();
+}
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <string.h>
+#include "grid_hierarchy.h"
+#include "io_util.h"
+
+// Magic number and version of checkpoint files
+static const char CHECKPOINT_MAGIC[8] = {'F', 'E', 'M', 'C', 'K', 'P', 'T', '\0'};
+static const uint32_t CHECKPOINT_VERSION = 3;
+
+// @brief Header of a checkpoint file
+// The header is followed by the array coarse_boundary_sides_ and, for
+// each level k, a byte which is 1 if level k is stored. A stored level
+// consists of the GRID (see GRID::write_checkpoint), the number of FE_VECs
+// as uint32_t and for each FE_VEC its name and its values.
+// Arrays are stored as number of entries followed by the entries, see
+// write_array.
+struct CheckpointHeader {
+	char magic_[8];
+	uint32_t version_;
+	uint32_t byte_order_;
+	uint32_t index_size_;
+	uint32_t num_levels_;
+};
+
+GridHierarchy::GridHierarchy(int num_levels, int num_threads)
+	: levels_(num_levels), num_threads_(num_threads) {
+	assert(num_levels > 0);
+	levels_[0] = std::make_shared<GRID>();
+}
+
+void GridHierarchy::read_from_file(const char* coords_filename, const char* conn_filename,
+                                   const char* bnd_filename) {
+	// drop all finer levels which belong to a previous coarse GRID
+	for(int k = 1; k < num_levels(); ++k) {
+		levels_[k].reset();
+	}
+	levels_[0] = std::make_shared<GRID>();
+	levels_[0]->read_from_file(coords_filename, conn_filename, num_threads_);
+	if(bnd_filename != NULL) {
+		levels_[0]->read_boundary_tags(bnd_filename);
+	}
+	init_coarse();
+}
+
+void GridHierarchy::read_binary(const char* filename) {
+	for(int k = 1; k < num_levels(); ++k) {
+		levels_[k].reset();
+	}
+	levels_[0] = std::make_shared<GRID>();
+	levels_[0]->read_binary(filename);
+	init_coarse();
+}
+
+void GridHierarchy::read_gmsh(const char* filename) {
+	for(int k = 1; k < num_levels(); ++k) {
+		levels_[k].reset();
+	}
+	levels_[0] = std::make_shared<GRID>();
+	levels_[0]->read_gmsh(filename);
+	init_coarse();
+}
+
+void GridHierarchy::init_coarse() {
+	GRID &coarse = *levels_[0];
+	coarse.compute_edge_table(num_threads_);
+
+	const std::vector<BoundaryEdge> &boundary_edges = coarse.boundary_edges();
+	std::vector<unsigned char> is_boundary(coarse.num_edges(), 0);
+	for(size_t i = 0; i < boundary_edges.size(); ++i) {
+		const index_t e = coarse.find_edge(boundary_edges[i].nodes_[0], boundary_edges[i].nodes_[1]);
+		if(e >= 0) {
+			is_boundary[e] = 1;
+		}
+	}
+
+	coarse_boundary_sides_.assign(coarse.num_triangles(), 0);
+	for(index_t t = 0; t < coarse.num_triangles(); ++t) {
+		for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+			if(is_boundary[coarse.get_triangle_edge(t, s)]) {
+				coarse_boundary_sides_[t] |= 1 << s;
+			}
+		}
+	}
+}
+
+std::shared_ptr<GRID> GridHierarchy::level_handle(int k) {
+	assert(k >= 0 && k < num_levels());
+	if(levels_[k]) {
+		return levels_[k];
+	}
+
+	// finest resident coarser level
+	int j = k - 1;
+	while(!levels_[j]) {
+		--j;
+	}
+
+	// refine level by level; levels generated in between are released again
+	for(int l = j; l < k; ++l) {
+		levels_[l+1] = std::make_shared<GRID>();
+		levels_[l]->refine_ip(NULL, 0, *levels_[l+1], NULL, num_threads_);
+		if(l > j) {
+			levels_[l].reset();
+		}
+	}
+	return levels_[k];
+}
+
+void GridHierarchy::release(int k) {
+	assert(k >= 0 && k < num_levels());
+	if(k == 0) {
+		std::cout << "The coarsest level of a GridHierarchy cannot be released." << std::endl;
+		return;
+	}
+	levels_[k].reset();
+}
+
+count_t GridHierarchy::num_triangles(int k) const {
+	assert(k >= 0 && k < num_levels());
+	return static_cast<count_t>(levels_[0]->num_triangles()) << (2 * k);
+}
+
+count_t GridHierarchy::num_nodes(int k) const {
+	assert(k >= 0 && k < num_levels());
+
+	// Uniform refinement adds one node per edge, splits every edge into two
+	// and adds three new edges in the interior of every triangle
+	count_t nodes = levels_[0]->num_nodes();
+	count_t edges = levels_[0]->num_edges();
+	count_t triangles = levels_[0]->num_triangles();
+	for(int l = 0; l < k; ++l) {
+		nodes += edges;
+		edges = 2 * edges + 3 * triangles;
+		triangles *= 4;
+	}
+	return nodes;
+}
+
+int GridHierarchy::write_checkpoint(const char* filename, const std::vector<std::vector<FE_VEC> > &vectors) const {
+	for(size_t k = 0; k < vectors.size(); ++k) {
+		if(!vectors[k].empty() && (k >= levels_.size() || !levels_[k])) {
+			std::cout << "FE_VECs given for level " << k << " which is not resident." << std::endl;
+			return -1;
+		}
+	}
+
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL) {
+		std::cout << "Could not open " << filename << " for writing." << std::endl;
+		return -1;
+	}
+
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic_, CHECKPOINT_MAGIC, sizeof(header.magic_));
+	header.version_ = CHECKPOINT_VERSION;
+	header.byte_order_ = is_little_endian();
+	header.index_size_ = sizeof(index_t);
+	header.num_levels_ = num_levels();
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && write_array(fp, coarse_boundary_sides_);
+	for(int k = 0; k < num_levels() && ok; ++k) {
+		const unsigned char resident = is_resident(k);
+		ok = fwrite(&resident, 1, 1, fp) == 1;
+		if(!resident || !ok) {
+			continue;
+		}
+		ok = levels_[k]->write_checkpoint(fp);
+
+		const uint32_t n_vectors = k < static_cast<int>(vectors.size()) ? vectors[k].size() : 0;
+		ok = ok && fwrite(&n_vectors, sizeof(n_vectors), 1, fp) == 1;
+		for(uint32_t i = 0; i < n_vectors && ok; ++i) {
+			const char *name = vectors[k][i].getName();
+			ok = write_array(fp, std::vector<char>(name, name + strlen(name)));
+			ok = ok && write_array(fp, vectors[k][i].getValues());
+		}
+	}
+
+	if(fclose(fp) != 0 || !ok) {
+		std::cout << "Error while writing " << filename << "." << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int GridHierarchy::read_checkpoint(const char* filename, std::vector<std::vector<FE_VEC> > &vectors) {
+	FILE *fp = fopen(filename, "rb");
+	if(fp == NULL) {
+		std::cout << "Could not open " << filename << " for reading." << std::endl;
+		return -1;
+	}
+
+	CheckpointHeader header;
+	if(fread(&header, sizeof(header), 1, fp) != 1
+	   || memcmp(header.magic_, CHECKPOINT_MAGIC, sizeof(header.magic_)) != 0
+	   || header.version_ != CHECKPOINT_VERSION) {
+		std::cout << filename << " is not a checkpoint file of this version." << std::endl;
+		fclose(fp);
+		return -1;
+	}
+	if(header.byte_order_ != static_cast<uint32_t>(is_little_endian()) || header.index_size_ != sizeof(index_t)
+	   || header.num_levels_ == 0) {
+		std::cout << filename << " has been written on a different machine or with different index_t." << std::endl;
+		fclose(fp);
+		return -1;
+	}
+
+	// each level takes at least its resident byte, i.e. a corrupt number of
+	// levels is detected before anything is allocated for it
+	if(header.num_levels_ > remaining_bytes(fp)) {
+		std::cout << filename << " is truncated or corrupt." << std::endl;
+		fclose(fp);
+		return -1;
+	}
+
+	// read into new objects, the hierarchy is only changed on success
+	std::vector<std::shared_ptr<GRID> > levels(header.num_levels_);
+	std::vector<unsigned char> coarse_boundary_sides;
+	std::vector<std::vector<FE_VEC> > vecs(header.num_levels_);
+
+	bool ok = read_array(fp, coarse_boundary_sides);
+	for(uint32_t k = 0; k < header.num_levels_ && ok; ++k) {
+		unsigned char resident;
+		ok = fread(&resident, 1, 1, fp) == 1 && (resident == 1 || (resident == 0 && k > 0));
+		if(!resident || !ok) {
+			continue;
+		}
+		levels[k] = std::make_shared<GRID>();
+		ok = levels[k]->read_checkpoint(fp);
+
+		uint32_t n_vectors;
+		ok = ok && fread(&n_vectors, sizeof(n_vectors), 1, fp) == 1;
+		for(uint32_t i = 0; i < n_vectors && ok; ++i) {
+			std::vector<char> name;
+			vecs[k].push_back(FE_VEC());
+			ok = read_array(fp, name) && read_array(fp, vecs[k].back().getValues());
+			ok = ok && vecs[k].back().length() == levels[k]->num_nodes();
+			vecs[k].back().setName(std::string(name.begin(), name.end()).c_str());
+		}
+	}
+	ok = ok && coarse_boundary_sides.size() == static_cast<size_t>(levels[0]->num_triangles());
+	for(uint32_t k = 0; k + 1 < header.num_levels_ && ok; ++k) {
+		ok = !levels[k] || !levels[k+1] || levels[k]->check_refinement_info(*levels[k+1]);
+	}
+	fclose(fp);
+
+	if(!ok) {
+		std::cout << filename << " is truncated or corrupt." << std::endl;
+		return -1;
+	}
+
+	levels_.swap(levels);
+	coarse_boundary_sides_.swap(coarse_boundary_sides);
+	vectors.swap(vecs);
+	return 0;
+}
@@ -0,0 +1,195 @@
+#ifndef _GRID_HIERARCHY_H_
+#define _GRID_HIERARCHY_H_
+
+#include <vector>
+#include <memory>
+
+#include "grid.h"
+#include "FE_VEC.h"
+
+/// @brief Hierarchy of uniformly refined GRIDs
+/// Only the coarsest GRID (level 0) is stored permanently. Finer levels are
+/// generated on demand via GRID::refine_ip from the finest resident coarser
+/// level and can be released again as soon as they are not needed anymore.
+/// Alternatively, the triangles of a level can be visited one by one
+/// without generating the level at all, see for_each_triangle().
+class GridHierarchy {
+private:
+	/// Resident levels; levels_[k] is empty if level k is not resident
+	std::vector<std::shared_ptr<GRID> > levels_;
+
+	/// Number of threads used for refinement
+	int num_threads_;
+
+	/// Boundary sides of the triangles on level 0
+	/// Bit s of coarse_boundary_sides_[t] is set if side s of triangle t
+	/// is on the boundary
+	std::vector<unsigned char> coarse_boundary_sides_;
+
+	/// Initialize data of coarsest level after it has been loaded
+	void init_coarse();
+
+	/// Recursively subdivide a triangle with vertices v down to the given
+	/// level and call f for each resulting triangle, see for_each_triangle()
+	template<class F>
+	void subdivide(int level, count_t index, const Coord v[NODES_PER_TRIANGLE], unsigned char boundary_sides, F &f) const;
+
+public:
+	/// Constructor
+	/// @param num_levels total number of levels including the coarsest one
+	/// @param num_threads number of threads used for refinement
+	GridHierarchy(int num_levels, int num_threads = 1);
+
+	/// Read coarsest GRID from given files, see GRID::read_from_file
+	/// If bnd_filename is given, the tags of the boundary edges are read
+	/// from it as well, see GRID::read_boundary_tags
+	void read_from_file(const char* coords_filename, const char* conn_filename,
+	                    const char* bnd_filename = NULL);
+
+	/// Read coarsest GRID from binary mesh file, see GRID::read_binary
+	void read_binary(const char* filename);
+
+	/// Read coarsest GRID from Gmsh mesh file, see GRID::read_gmsh
+	void read_gmsh(const char* filename);
+
+	/// Write checkpoint of the hierarchy, i.e. all resident levels with
+	/// their boundary flags, edge tables and refinement information and
+	/// the FE_VECs on these levels, to one file
+	/// Levels which are not resident are not stored and are generated on
+	/// demand after a restart as usual.
+	/// @param filename file to write to, will be overwritten
+	/// @param vectors vectors[k] are the FE_VECs on level k; may be shorter
+	/// than num_levels() and must be empty for levels which are not resident
+	/// @return 0 on success, -1 otherwise
+	int write_checkpoint(const char* filename,
+	                     const std::vector<std::vector<FE_VEC> > &vectors = std::vector<std::vector<FE_VEC> >()) const;
+
+	/// Restart from a checkpoint written by write_checkpoint
+	/// The hierarchy is replaced by the one in the file, including its
+	/// number of levels.
+	/// @param filename file to read from
+	/// @param[out] vectors vectors[k] are the FE_VECs on level k
+	/// @return 0 on success, -1 otherwise
+	int read_checkpoint(const char* filename, std::vector<std::vector<FE_VEC> > &vectors);
+
+	/// Write level k to a binary mesh file (see mesh_file.h) without
+	/// generating level k in memory
+	/// Each refined coarse triangle is split into blocks of rows of its
+	/// nodes and into tiles of its triangles (the triangles of an
+	/// intermediate level, refined further), such that there are several
+	/// blocks and tiles per thread even for few coarse triangles. Blocks and
+	/// tiles are processed in parallel in num_threads contiguous ranges and
+	/// written in buffered contiguous pieces. The rows of nodes are
+	/// generated in ascending order by recursive bisection, i.e. only the
+	/// coarse GRID and, per thread, O(k) rows of 2^k+1 coordinates and the
+	/// write buffers are held in memory.
+	/// The nodes are numbered in closed form: first the coarse nodes, then
+	/// the 2^k-1 new nodes of each coarse edge in the order of the edges
+	/// (from edge_node(e, 0) to edge_node(e, 1)) and finally the interior
+	/// nodes of each coarse triangle row by row. Triangles, their vertex
+	/// order and all coordinates are the same as on level(k), only the
+	/// node numbering differs. The boundary block marks all nodes on
+	/// boundary edges of the coarse GRID; the boundary edges and their tags
+	/// are the same as on level(k).
+	/// If the mesh exceeds the range of index_t, 8 byte vertex numbers are
+	/// written.
+	/// @param k level to write
+	/// @param filename file to write to, will be overwritten
+	/// @param with_boundary if true, the boundary block is written as well
+	/// @param buffer_size size of each write buffer in bytes
+	/// @return 0 on success, -1 otherwise
+	int write_binary(int k, const char* filename, bool with_boundary = true,
+	                 size_t buffer_size = 1 << 22) const;
+
+	/// Get total number of levels
+	int num_levels() const {
+		return static_cast<int>(levels_.size());
+	}
+
+	/// Check if level k is currently stored
+	bool is_resident(int k) const {
+		assert(k >= 0 && k < num_levels());
+		return static_cast<bool>(levels_[k]);
+	}
+
+	/// Get GRID on level k
+	/// If level k is not resident, it is generated from the finest resident
+	/// coarser level. Levels generated in between are released again.
+	GRID& level(int k) {
+		return *level_handle(k);
+	}
+
+	/// Get shared handle to the GRID on level k, see level()
+	/// The GRID stays alive as long as the handle exists, even if the
+	/// level is released in the meantime
+	std::shared_ptr<GRID> level_handle(int k);
+
+	/// Release level k. The coarsest level cannot be released.
+	void release(int k);
+
+	/// Number of triangles on level k (without generating level k)
+	count_t num_triangles(int k) const;
+
+	/// Number of nodes on level k (without generating level k)
+	count_t num_nodes(int k) const;
+
+	/// Visit all triangles on level k without generating level k
+	/// f(index, v, boundary_sides) is called for each triangle in the order of
+	/// the triangle numbers on level k, where index is the triangle number,
+	/// v are the coordinates of the three vertices (as computed by
+	/// GRID::refine_ip) and bit s of boundary_sides is set if side s of the
+	/// triangle is on the boundary.
+	template<class F>
+	void for_each_triangle(int k, F f) const;
+};
+
+/*****************************************************************************/
+/* Template implementations                                                  */
+/*****************************************************************************/
+
+template<class F>
+void GridHierarchy::subdivide(int level, count_t index, const Coord v[NODES_PER_TRIANGLE], unsigned char boundary_sides, F &f) const {
+	if(level == 0) {
+		f(index, v, boundary_sides);
+		return;
+	}
+
+	// new vertices in the middle of the three sides
+	Coord m[NODES_PER_TRIANGLE];
+	for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+		m[s][0] = (v[s][0] + v[(s+1) % NODES_PER_TRIANGLE][0]) * 0.5;
+		m[s][1] = (v[s][1] + v[(s+1) % NODES_PER_TRIANGLE][1]) * 0.5;
+	}
+
+	// the four children in the same order and orientation as in
+	// GRID::refine_ip; sides of children on sides of the parent inherit
+	// the boundary information
+	const unsigned char b0 = boundary_sides & 1;
+	const unsigned char b1 = (boundary_sides >> 1) & 1;
+	const unsigned char b2 = (boundary_sides >> 2) & 1;
+
+	Coord c[NODES_PER_TRIANGLE];
+	c[0] = v[0]; c[1] = m[0]; c[2] = m[2];
+	subdivide(level - 1, 4 * index, c, b0 | (b2 << 2), f);
+	c[0] = m[0]; c[1] = m[1]; c[2] = m[2];
+	subdivide(level - 1, 4 * index + 1, c, 0, f);
+	c[0] = m[0]; c[1] = v[1]; c[2] = m[1];
+	subdivide(level - 1, 4 * index + 2, c, b0 | (b1 << 1), f);
+	c[0] = m[2]; c[1] = m[1]; c[2] = v[2];
+	subdivide(level - 1, 4 * index + 3, c, (b1 << 1) | (b2 << 2), f);
+}
+
+template<class F>
+void GridHierarchy::for_each_triangle(int k, F f) const {
+	assert(k >= 0 && k < num_levels());
+	GRID &coarse = *levels_[0];
+	Coord v[NODES_PER_TRIANGLE];
+	for(index_t t = 0; t < coarse.num_triangles(); ++t) {
+		for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+			v[s] = coarse.get_coordinates(coarse.get_triangle(t)[s]);
+		}
+		subdivide(k, t, v, coarse_boundary_sides_[t], f);
+	}
+}
+
+#endif
@@ -0,0 +1,487 @@
+/// Streaming output of refined levels of a GridHierarchy, see
+/// GridHierarchy::write_binary
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <limits>
+#include <string>
+#include "grid_hierarchy.h"
+#include "mesh_file.h"
+#include "io_util.h"
+#include "parallel.h"
+
+// Buffered writer for a contiguous range of a file starting at a given
+// offset; the buffer is written with one pwrite as soon as it is full
+class RangeWriter {
+private:
+	int fd_;
+	uint64_t offset_;
+	size_t capacity_;
+	std::string buffer_;
+	bool ok_;
+
+public:
+	RangeWriter(int fd, uint64_t offset, size_t capacity)
+		: fd_(fd), offset_(offset), capacity_(capacity), ok_(true) {
+		buffer_.reserve(capacity);
+	}
+
+	void append(const void *data, size_t size) {
+		if(buffer_.size() + size > capacity_) {
+			flush();
+		}
+		buffer_.append(static_cast<const char*>(data), size);
+	}
+
+	template<class T>
+	void append_value(T value) {
+		append(&value, sizeof(T));
+	}
+
+	// Write buffered data, returns false if any write failed so far
+	bool flush() {
+		ok_ = ok_ && pwrite_all(fd_, buffer_, offset_);
+		offset_ += buffer_.size();
+		buffer_.clear();
+		return ok_;
+	}
+};
+
+// Node numbers of the lattice points (a, b), a, b >= 0, a + b <= m, of
+// refined coarse triangle t; the lattice point (a, b) has the coordinates
+// v0 + a/m (v1 - v0) + b/m (v2 - v0). See GridHierarchy::write_binary for
+// the numbering.
+struct LatticeNumbering {
+	count_t m_;
+	count_t corner_[NODES_PER_TRIANGLE];
+	// number of the first new node on side s and whether side s has the
+	// same orientation as its edge
+	count_t edge_first_[NODES_PER_TRIANGLE];
+	bool forward_[NODES_PER_TRIANGLE];
+	count_t interior_first_;
+
+	// node at position pos = 1, ..., m-1 on side s counted from vertex s
+	count_t edge(int s, count_t pos) const {
+		return edge_first_[s] + (forward_[s] ? pos : m_ - pos) - 1;
+	}
+
+	count_t operator()(count_t a, count_t b) const {
+		if(b == 0) {
+			return a == 0 ? corner_[0] : (a == m_ ? corner_[1] : edge(0, a));
+		}
+		if(a == 0) {
+			return b == m_ ? corner_[2] : edge(2, m_ - b);
+		}
+		if(a + b == m_) {
+			return edge(1, b);
+		}
+		// interior rows b = 1, ..., m-2 with a = 1, ..., m-1-b
+		return interior_first_ + (b - 1) * (m_ - 1) - (b - 1) * b / 2 + a - 1;
+	}
+};
+
+// Number of interior lattice points of a refined coarse triangle in the
+// rows 1, ..., b-1, i.e. position of the first interior point of row b >= 1
+static inline count_t interior_rows_before(count_t m, count_t b) {
+	return (b - 1) * (m - 1) - (b - 1) * b / 2;
+}
+
+// Generator of the coordinates of the lattice points of one refined coarse
+// triangle row by row (row b holds the points (a, b), a = 0, ..., m-b)
+// The rows are computed by repeated bisection as done by GRID::refine_ip,
+// i.e. with bitwise identical results: row b with lowest set bit s is
+// computed from the rows b-s and b+s, the points within a row at finer
+// strides from their neighbours in the row. Only one row per recursion
+// depth is held in memory.
+class LatticeRows {
+private:
+	count_t m_;
+	// rows_[i] is the buffer for rows with lowest set bit 2^i, rows_[k+1]
+	// and rows_[k+2] hold the rows at the ends of the current interval
+	std::vector<std::vector<double> > rows_;
+
+	// Compute row b = lower row + s from the rows b-s and b+s
+	void compute_row(count_t b, count_t s, const double *lower, const double *upper, double *x) const {
+		const count_t len = m_ - b;
+		for(count_t a = 0; a <= len; a += s) {
+			if((a / s) % 2 == 0) {
+				x[a] = (lower[a] + upper[a]) * 0.5;
+			}
+			else {
+				x[a] = (upper[a - s] + lower[a + s]) * 0.5;
+			}
+		}
+		for(count_t h = s / 2; h >= 1; h /= 2) {
+			for(count_t a = h; a < len; a += 2 * h) {
+				x[a] = (x[a - h] + x[a + h]) * 0.5;
+			}
+		}
+	}
+
+	// Emit the rows lo+1, ..., hi-1 in ascending order, given rows lo and hi
+	template<class E>
+	void visit(count_t lo, count_t hi, const double *lower, const double *upper, int depth, E &emit) {
+		if(hi - lo < 2) {
+			return;
+		}
+		const count_t s = (hi - lo) / 2;
+		double *mid = rows_[depth].data();
+		compute_row(lo + s, s, lower, upper, mid);
+		visit(lo, lo + s, lower, mid, depth - 1, emit);
+		emit(lo + s, mid);
+		visit(lo + s, hi, mid, upper, depth - 1, emit);
+	}
+
+public:
+	explicit LatticeRows(int k) : m_(count_t(1) << k), rows_(k + 3, std::vector<double>(m_ + 1)) {
+	}
+
+	// Call emit(b, x) for the rows b = lo, ..., lo+size-1 in ascending
+	// order, where x[a] is the coordinate of lattice point (a, b); size is a
+	// power of two and lo a multiple of size; x0, x1, x2 are the coordinates
+	// of the vertices (0, 0), (m, 0) and (0, m)
+	template<class E>
+	void generate(count_t lo, count_t size, double x0, double x1, double x2, E emit) {
+		const int k = static_cast<int>(rows_.size()) - 3;
+		double *lower = rows_[k + 1].data();
+		double *upper = rows_[k + 2].data();
+
+		// rows 0 and m
+		lower[0] = x0;
+		lower[m_] = x1;
+		for(count_t h = m_ / 2; h >= 1; h /= 2) {
+			for(count_t a = h; a < m_; a += 2 * h) {
+				lower[a] = (lower[a - h] + lower[a + h]) * 0.5;
+			}
+		}
+		upper[0] = x2;
+
+		// descend to the interval [lo, lo+size]
+		count_t begin = 0, end = m_;
+		int depth = k - 1;
+		while(end - begin > size) {
+			const count_t s = (end - begin) / 2;
+			double *mid = rows_[depth].data();
+			compute_row(begin + s, s, lower, upper, mid);
+			if(lo < begin + s) {
+				rows_[depth].swap(rows_[k + 2]);
+				upper = rows_[k + 2].data();
+				end = begin + s;
+			}
+			else {
+				rows_[depth].swap(rows_[k + 1]);
+				lower = rows_[k + 1].data();
+				begin = begin + s;
+			}
+			--depth;
+		}
+
+		emit(begin, static_cast<const double*>(lower));
+		visit(begin, end, lower, upper, depth, emit);
+	}
+};
+
+// Recursively subdivide the lattice triangle (a[j], b[j]) in the same way
+// as GridHierarchy::subdivide and append the node numbers of the resulting
+// triangles to conn
+template<class I>
+static void write_lattice_triangles(int level, const count_t a[NODES_PER_TRIANGLE], const count_t b[NODES_PER_TRIANGLE],
+                                    const LatticeNumbering &numbering, RangeWriter &conn) {
+	if(level == 0) {
+		for(int j = 0; j < NODES_PER_TRIANGLE; ++j) {
+			conn.append_value(static_cast<I>(numbering(a[j], b[j])));
+		}
+		return;
+	}
+
+	// midpoints of the three sides
+	count_t ma[NODES_PER_TRIANGLE], mb[NODES_PER_TRIANGLE];
+	for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+		ma[s] = (a[s] + a[(s+1) % NODES_PER_TRIANGLE]) / 2;
+		mb[s] = (b[s] + b[(s+1) % NODES_PER_TRIANGLE]) / 2;
+	}
+
+	const count_t a0[NODES_PER_TRIANGLE] = {a[0], ma[0], ma[2]};
+	const count_t b0[NODES_PER_TRIANGLE] = {b[0], mb[0], mb[2]};
+	write_lattice_triangles<I>(level - 1, a0, b0, numbering, conn);
+	const count_t a1[NODES_PER_TRIANGLE] = {ma[0], ma[1], ma[2]};
+	const count_t b1[NODES_PER_TRIANGLE] = {mb[0], mb[1], mb[2]};
+	write_lattice_triangles<I>(level - 1, a1, b1, numbering, conn);
+	const count_t a2[NODES_PER_TRIANGLE] = {ma[0], a[1], ma[1]};
+	const count_t b2[NODES_PER_TRIANGLE] = {mb[0], b[1], mb[1]};
+	write_lattice_triangles<I>(level - 1, a2, b2, numbering, conn);
+	const count_t a3[NODES_PER_TRIANGLE] = {ma[2], ma[1], a[2]};
+	const count_t b3[NODES_PER_TRIANGLE] = {mb[2], mb[1], b[2]};
+	write_lattice_triangles<I>(level - 1, a3, b3, numbering, conn);
+}
+
+// Numbering of the lattice points of coarse triangle t refined k times
+static LatticeNumbering lattice_numbering(GRID &coarse, int k, index_t t) {
+	const count_t m = count_t(1) << k;
+	const count_t nn = coarse.num_nodes();
+	const count_t ne = coarse.num_edges();
+	const Triangle &tri = coarse.get_triangle(t);
+
+	LatticeNumbering numbering;
+	numbering.m_ = m;
+	for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+		const index_t e = coarse.get_triangle_edge(t, s);
+		numbering.corner_[s] = tri[s];
+		numbering.edge_first_[s] = nn + e * (m - 1);
+		numbering.forward_[s] = coarse.edge_node(e, 0) == tri[s];
+	}
+	numbering.interior_first_ = nn + ne * (m - 1) + t * ((m - 1) * (m - 2) / 2);
+	return numbering;
+}
+
+// Smallest level j <= k such that num * factor^j >= min_items
+static int split_level(count_t num, count_t factor, int k, count_t min_items) {
+	int j = 0;
+	while(j < k && num < min_items) {
+		num *= factor;
+		++j;
+	}
+	return j;
+}
+
+// Write the interior nodes of the row blocks [begin, end); row block q
+// consists of the rows (q % 2^j) * 2^(k-j), ... of coarse triangle q / 2^j
+static bool write_interior_nodes(GRID &coarse, int k, int j, count_t begin, count_t end,
+                                 int fd, const MeshFileHeader &header, size_t buffer_size) {
+	const count_t m = count_t(1) << k;
+	const count_t nn = coarse.num_nodes();
+	const count_t ne = coarse.num_edges();
+	const count_t interior_per_triangle = (m - 1) * (m - 2) / 2;
+	const count_t size = count_t(1) << (k - j);
+
+	// the interior nodes of consecutive row blocks are contiguous in the file
+	const count_t t0 = begin >> j;
+	const count_t lo0 = (begin & ((count_t(1) << j) - 1)) * size;
+	const count_t first = nn + ne * (m - 1) + t0 * interior_per_triangle + interior_rows_before(m, std::max(lo0, count_t(1)));
+
+	LatticeRows lattice(k);
+	bool ok = true;
+	for(int d = 0; d < NDIM; ++d) {
+		RangeWriter coords(fd, header.coords_offset_[d] + first * sizeof(double), buffer_size);
+		const double *x = coarse.coordinates(d);
+		for(count_t q = begin; q < end; ++q) {
+			const Triangle &tri = coarse.get_triangle(static_cast<index_t>(q >> j));
+			const count_t lo = (q & ((count_t(1) << j) - 1)) * size;
+			lattice.generate(lo, size, x[tri[0]], x[tri[1]], x[tri[2]], [&](count_t b, const double *row) {
+				if(b >= 1 && b <= m - 2) {
+					coords.append(row + 1, (m - 1 - b) * sizeof(double));
+				}
+			});
+		}
+		ok = coords.flush() && ok;
+	}
+	return ok;
+}
+
+// Write the triangles of the tiles [begin, end), I is the type of the vertex
+// numbers in the file; tile q is the triangle q % 4^j on level j within
+// coarse triangle q / 4^j, refined k-j more times
+template<class I>
+static bool write_tile_triangles(GRID &coarse, int k, int j, count_t begin, count_t end,
+                                 int fd, const MeshFileHeader &header, size_t buffer_size) {
+	const count_t m = count_t(1) << k;
+	const count_t triangles_per_tile = count_t(1) << (2 * (k - j));
+	RangeWriter conn(fd, header.conn_offset_ + static_cast<uint64_t>(begin) * triangles_per_tile * NODES_PER_TRIANGLE * sizeof(I), buffer_size);
+
+	LatticeNumbering numbering;
+	index_t current = -1;
+	for(count_t q = begin; q < end; ++q) {
+		const index_t t = static_cast<index_t>(q >> (2 * j));
+		if(t != current) {
+			numbering = lattice_numbering(coarse, k, t);
+			current = t;
+		}
+
+		// vertices of the tile, following the children as in
+		// write_lattice_triangles
+		count_t a[NODES_PER_TRIANGLE] = {0, m, 0};
+		count_t b[NODES_PER_TRIANGLE] = {0, 0, m};
+		for(int i = j - 1; i >= 0; --i) {
+			count_t ma[NODES_PER_TRIANGLE], mb[NODES_PER_TRIANGLE];
+			for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+				ma[s] = (a[s] + a[(s+1) % NODES_PER_TRIANGLE]) / 2;
+				mb[s] = (b[s] + b[(s+1) % NODES_PER_TRIANGLE]) / 2;
+			}
+			switch((q >> (2 * i)) & 3) {
+			case 0:
+				a[1] = ma[0]; b[1] = mb[0]; a[2] = ma[2]; b[2] = mb[2];
+				break;
+			case 1:
+				a[0] = ma[0]; b[0] = mb[0]; a[1] = ma[1]; b[1] = mb[1]; a[2] = ma[2]; b[2] = mb[2];
+				break;
+			case 2:
+				a[0] = ma[0]; b[0] = mb[0]; a[2] = ma[1]; b[2] = mb[1];
+				break;
+			default:
+				a[0] = ma[2]; b[0] = mb[2]; a[1] = ma[1]; b[1] = mb[1];
+				break;
+			}
+		}
+
+		write_lattice_triangles<I>(k - j, a, b, numbering, conn);
+	}
+	return conn.flush();
+}
+
+int GridHierarchy::write_binary(int k, const char* filename, bool with_boundary, size_t buffer_size) const {
+	assert(k >= 0 && k < num_levels());
+	GRID &coarse = *levels_[0];
+
+	const count_t m = count_t(1) << k;
+	const count_t nn0 = coarse.num_nodes();
+	const count_t ne0 = coarse.num_edges();
+	const count_t nn = num_nodes(k);
+	const count_t nt = num_triangles(k);
+
+	// vertex numbers are written as index_t if possible
+	const uint32_t index_size = nn - 1 > std::numeric_limits<index_t>::max() ? sizeof(int64_t) : sizeof(index_t);
+	const std::vector<BoundaryEdge> &coarse_boundary = coarse.boundary_edges();
+	const count_t nb = static_cast<count_t>(coarse_boundary.size()) * m;
+	const MeshFileHeader header = mesh_file_header(NDIM, nn, nt, index_size, with_boundary, nb);
+
+	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		std::cout << "Could not open " << filename << " for writing." << std::endl;
+		return -1;
+	}
+
+	// the file is created with its final size; padding and the boundary
+	// flags of the interior nodes are zero
+	const std::string header_data(reinterpret_cast<const char*>(&header), sizeof(header));
+	bool ok = ftruncate(fd, header.file_size_) == 0 && pwrite_all(fd, header_data, 0);
+
+	// boundary edges of the coarse GRID
+	std::vector<unsigned char> boundary_edge(ne0, 0);
+	for(index_t t = 0; t < coarse.num_triangles(); ++t) {
+		for(int s = 0; s < NODES_PER_TRIANGLE; ++s) {
+			if(coarse_boundary_sides_[t] & (1 << s)) {
+				boundary_edge[coarse.get_triangle_edge(t, s)] = 1;
+			}
+		}
+	}
+
+	// coarse nodes
+	for(int d = 0; d < NDIM; ++d) {
+		RangeWriter coords(fd, header.coords_offset_[d], buffer_size);
+		coords.append(coarse.coordinates(d), nn0 * sizeof(double));
+		ok = coords.flush() && ok;
+	}
+	if(with_boundary) {
+		std::vector<unsigned char> flags(nn0, 0);
+		for(index_t e = 0; e < ne0; ++e) {
+			if(boundary_edge[e]) {
+				flags[coarse.edge_node(e, 0)] = 1;
+				flags[coarse.edge_node(e, 1)] = 1;
+			}
+		}
+		RangeWriter boundary(fd, header.boundary_offset_, buffer_size);
+		boundary.append(flags.data(), nn0);
+		ok = boundary.flush() && ok;
+
+		// every coarse boundary edge is split into m edges in the same order
+		// as by m-fold GRID::refine_ip
+		RangeWriter edges(fd, header.boundary_edges_offset_, buffer_size);
+		RangeWriter tags(fd, header.boundary_tags_offset_, buffer_size);
+		for(size_t i = 0; i < coarse_boundary.size(); ++i) {
+			const index_t a = coarse_boundary[i].nodes_[0];
+			const index_t b = coarse_boundary[i].nodes_[1];
+			const index_t e = coarse.find_edge(a, b);
+			if(e < 0) {
+				ok = false;
+				break;
+			}
+			const bool forward = coarse.edge_node(e, 0) == a;
+			for(count_t pos = 0; pos < m; ++pos) {
+				for(count_t end = pos; end <= pos + 1; ++end) {
+					const count_t node = end == 0 ? a : (end == m ? b : nn0 + e * (m - 1) + (forward ? end : m - end) - 1);
+					if(index_size == sizeof(int32_t)) {
+						edges.append_value(static_cast<int32_t>(node));
+					} else {
+						edges.append_value(static_cast<int64_t>(node));
+					}
+				}
+				tags.append_value(static_cast<int32_t>(coarse_boundary[i].tag_));
+			}
+		}
+		ok = edges.flush() && ok;
+		ok = tags.flush() && ok;
+	}
+
+	// new nodes in the coarse edges, edge by edge
+	std::vector<char> edge_ok(num_chunks(count_t(0), ne0, num_threads_), 1);
+	parallel_for(count_t(0), ne0, num_threads_, [&](count_t begin, count_t end, int c) {
+		std::vector<RangeWriter> coords;
+		for(int d = 0; d < NDIM; ++d) {
+			coords.push_back(RangeWriter(fd, header.coords_offset_[d] + (nn0 + begin * (m - 1)) * sizeof(double), buffer_size));
+		}
+		RangeWriter boundary(fd, header.boundary_offset_ + nn0 + begin * (m - 1), buffer_size);
+		std::vector<double> x(m + 1);
+		const std::string flags[2] = {std::string(m - 1, 0), std::string(m - 1, 1)};
+		for(count_t e = begin; e < end; ++e) {
+			for(int d = 0; d < NDIM; ++d) {
+				// bisection as in GRID::refine_ip
+				x[0] = coarse.coordinates(d)[coarse.edge_node(e, 0)];
+				x[m] = coarse.coordinates(d)[coarse.edge_node(e, 1)];
+				for(count_t s = m / 2; s >= 1; s /= 2) {
+					for(count_t i = s; i < m; i += 2 * s) {
+						x[i] = (x[i - s] + x[i + s]) * 0.5;
+					}
+				}
+				coords[d].append(x.data() + 1, (m - 1) * sizeof(double));
+			}
+			if(with_boundary) {
+				boundary.append(flags[boundary_edge[e]].data(), m - 1);
+			}
+		}
+		bool chunk_result = true;
+		for(int d = 0; d < NDIM; ++d) {
+			chunk_result = coords[d].flush() && chunk_result;
+		}
+		chunk_result = (!with_boundary || boundary.flush()) && chunk_result;
+		edge_ok[c] = chunk_result;
+	});
+
+	// interior nodes, in blocks of rows of the refined coarse triangles,
+	// and triangles, in tiles of the refined coarse triangles; there are at
+	// least ITEMS_PER_THREAD blocks and tiles per thread (if k allows)
+	const count_t ITEMS_PER_THREAD = 8;
+	const count_t nt0 = coarse.num_triangles();
+	const int row_level = split_level(nt0, 2, k, ITEMS_PER_THREAD * num_threads_);
+	const count_t num_blocks = nt0 << row_level;
+	std::vector<char> interior_ok(num_chunks(count_t(0), num_blocks, num_threads_), 1);
+	parallel_for(count_t(0), num_blocks, num_threads_, [&](count_t begin, count_t end, int c) {
+		interior_ok[c] = write_interior_nodes(coarse, k, row_level, begin, end, fd, header, buffer_size);
+	});
+
+	const int tile_level = split_level(nt0, 4, k, ITEMS_PER_THREAD * num_threads_);
+	const count_t num_tiles = nt0 << (2 * tile_level);
+	std::vector<char> triangle_ok(num_chunks(count_t(0), num_tiles, num_threads_), 1);
+	parallel_for(count_t(0), num_tiles, num_threads_, [&](count_t begin, count_t end, int c) {
+		triangle_ok[c] = index_size == sizeof(index_t)
+			? write_tile_triangles<index_t>(coarse, k, tile_level, begin, end, fd, header, buffer_size)
+			: write_tile_triangles<int64_t>(coarse, k, tile_level, begin, end, fd, header, buffer_size);
+	});
+
+	for(size_t c = 0; c < edge_ok.size(); ++c) {
+		ok = ok && edge_ok[c];
+	}
+	for(size_t c = 0; c < interior_ok.size(); ++c) {
+		ok = ok && interior_ok[c];
+	}
+	for(size_t c = 0; c < triangle_ok.size(); ++c) {
+		ok = ok && triangle_ok[c];
+	}
+	if(close(fd) != 0 || !ok) {
+		std::cout << "Error while writing " << filename << "." << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef _INDEX_H_
+#define _INDEX_H_
+
+#include <stdint.h>
+
+///*******************************************************************
+/// Integer types used for indexing nodes, triangles and edges
+///*******************************************************************
+
+/// Type of node, triangle and edge numbers as stored in GRID, Triangle
+/// and FE_VEC. 32-bit by default to keep the storage compact; compile
+/// with -DGRID_LARGE_INDEX for GRIDs with more than 2^31-1 nodes or
+/// triangles
+#ifdef GRID_LARGE_INDEX
+typedef int64_t index_t;
+#else
+typedef int32_t index_t;
+#endif
+
+/// Type for counts and positions which may exceed the range of the
+/// node/triangle numbers, e.g. positions in arrays with one entry per
+/// triangle side
+typedef int64_t count_t;
+
+#endif
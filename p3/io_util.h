@@ -0,0 +1,68 @@
+#ifndef _IO_UTIL_H_
+#define _IO_UTIL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+///*******************************************************************
+/// Small helpers shared by the input and output routines
+///*******************************************************************
+
+/// Byte order of this machine, needed e.g. for the VTKFile header
+inline bool is_little_endian() {
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+/// Write all of buf to file descriptor fd at offset, retry after partial
+/// writes
+/// @return true on success
+inline bool pwrite_all(int fd, const std::string &buf, long offset) {
+	size_t done = 0;
+	while (done < buf.size()) {
+		ssize_t n = pwrite(fd, buf.data() + done, buf.size() - done, offset + done);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+/// Write the number of entries (as uint64_t) and the entries of v to fp
+/// T has to be trivially copyable
+/// @return true on success
+template<class T, class A>
+bool write_array(FILE *fp, const std::vector<T, A> &v) {
+	const uint64_t n = v.size();
+	return fwrite(&n, sizeof(n), 1, fp) == 1
+	       && (n == 0 || fwrite(v.data(), sizeof(T), n, fp) == n);
+}
+
+/// Number of bytes from the current position to the end of fp
+inline uint64_t remaining_bytes(FILE *fp) {
+	struct stat st;
+	long pos = ftell(fp);
+	if (pos < 0 || fstat(fileno(fp), &st) != 0 || st.st_size < pos) {
+		return 0;
+	}
+	return st.st_size - pos;
+}
+
+/// Read an array written by write_array from fp into v
+/// @return false if fp does not contain the complete array
+template<class T, class A>
+bool read_array(FILE *fp, std::vector<T, A> &v) {
+	uint64_t n;
+	if (fread(&n, sizeof(n), 1, fp) != 1 || n > remaining_bytes(fp) / sizeof(T)) {
+		return false;
+	}
+	v.resize(n);
+	return n == 0 || fread(v.data(), sizeof(T), n, fp) == n;
+}
+
+#endif
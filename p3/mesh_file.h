@@ -0,0 +1,124 @@
+#ifndef _MESH_FILE_H_
+#define _MESH_FILE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+///*******************************************************************
+/// Layout of the binary mesh file written by GRID::write_binary and
+/// read by GRID::read_binary
+///
+/// The file starts with a MeshFileHeader followed by the data blocks
+///   - coordinate block d (d = 0, ..., ndim_-1): num_nodes_ doubles
+///   - connectivity block: 3 * num_triangles_ integers of index_size_
+///     bytes each, vertices of triangle t at positions 3*t, 3*t+1, 3*t+2
+///     (0-based)
+///   - optional boundary block: num_nodes_ bytes, 1 for boundary nodes
+///   - optional boundary edge blocks (since version 2): 2 * num_boundary_edges_
+///     integers of index_size_ bytes, end nodes of boundary edge i at
+///     positions 2*i, 2*i+1, followed by a block of num_boundary_edges_
+///     int32_t tags
+/// Every block starts at a multiple of MESH_FILE_BLOCK_ALIGNMENT bytes
+/// so that a memory mapped file can be used as aligned arrays directly.
+/// All numbers are stored in the byte order of the writing machine;
+/// byte_order_ is used to detect files from a machine with different
+/// byte order.
+///*******************************************************************
+
+/// Magic number at the beginning of every mesh file
+const char MESH_FILE_MAGIC[8] = {'F', 'E', 'M', 'M', 'E', 'S', 'H', '\0'};
+
+/// Current version of the file format
+/// Version 2 added the boundary edge blocks; files of version 1 are read
+/// as well.
+const uint32_t MESH_FILE_VERSION = 2;
+
+/// Value of MeshFileHeader::byte_order_ as written by the writer
+const uint32_t MESH_FILE_BYTE_ORDER = 0x01020304;
+
+/// Alignment of the data blocks in bytes
+const uint64_t MESH_FILE_BLOCK_ALIGNMENT = 64;
+
+/// Bits in MeshFileHeader::flags_
+enum MeshFileFlags {
+	/// File contains the boundary block
+	MESH_FILE_HAS_BOUNDARY = 1,
+	/// File contains the boundary edge blocks
+	MESH_FILE_HAS_BOUNDARY_EDGES = 2
+};
+
+/// Maximum number of coordinate blocks
+const int MESH_FILE_MAX_DIM = 3;
+
+/// @brief Header of a binary mesh file
+/// All offsets are in bytes wrt. the beginning of the file
+struct MeshFileHeader {
+	char magic_[8];
+	uint32_t version_;
+	uint32_t byte_order_;
+	/// Space dimension, i.e. number of coordinate blocks
+	uint32_t ndim_;
+	/// Size of one vertex number in the connectivity block in bytes (4 or 8)
+	uint32_t index_size_;
+	/// Combination of MeshFileFlags
+	uint32_t flags_;
+	uint32_t reserved_;
+	uint64_t num_nodes_;
+	uint64_t num_triangles_;
+	uint64_t coords_offset_[MESH_FILE_MAX_DIM];
+	uint64_t conn_offset_;
+	uint64_t boundary_offset_;
+	/// Total size of the file
+	uint64_t file_size_;
+	/// Boundary edges, only valid if MESH_FILE_HAS_BOUNDARY_EDGES is set;
+	/// these fields are zero in files of version 1 as the header is
+	/// padded with zeros
+	uint64_t num_boundary_edges_;
+	uint64_t boundary_edges_offset_;
+	uint64_t boundary_tags_offset_;
+};
+
+/// Round offset up to the next multiple of MESH_FILE_BLOCK_ALIGNMENT
+inline uint64_t mesh_file_align(uint64_t offset) {
+	return (offset + MESH_FILE_BLOCK_ALIGNMENT - 1) / MESH_FILE_BLOCK_ALIGNMENT * MESH_FILE_BLOCK_ALIGNMENT;
+}
+
+/// Header of a mesh file with the given sizes, including the offsets of
+/// all blocks and the total file size
+/// If with_boundary is true, the file contains the boundary block and the
+/// boundary edge blocks.
+inline MeshFileHeader mesh_file_header(uint32_t ndim, uint64_t num_nodes, uint64_t num_triangles,
+                                       uint32_t index_size, bool with_boundary,
+                                       uint64_t num_boundary_edges = 0) {
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic_, MESH_FILE_MAGIC, sizeof(header.magic_));
+	header.version_ = MESH_FILE_VERSION;
+	header.byte_order_ = MESH_FILE_BYTE_ORDER;
+	header.ndim_ = ndim;
+	header.index_size_ = index_size;
+	header.flags_ = with_boundary ? MESH_FILE_HAS_BOUNDARY | MESH_FILE_HAS_BOUNDARY_EDGES : 0;
+	header.num_nodes_ = num_nodes;
+	header.num_triangles_ = num_triangles;
+
+	uint64_t offset = mesh_file_align(sizeof(MeshFileHeader));
+	for(uint32_t d = 0; d < ndim; ++d) {
+		header.coords_offset_[d] = offset;
+		offset += mesh_file_align(num_nodes * sizeof(double));
+	}
+	header.conn_offset_ = offset;
+	offset += mesh_file_align(3 * num_triangles * index_size);
+	if(with_boundary) {
+		header.boundary_offset_ = offset;
+		offset += mesh_file_align(num_nodes);
+		header.num_boundary_edges_ = num_boundary_edges;
+		header.boundary_edges_offset_ = offset;
+		offset += mesh_file_align(2 * num_boundary_edges * index_size);
+		header.boundary_tags_offset_ = offset;
+		offset += mesh_file_align(num_boundary_edges * sizeof(int32_t));
+	}
+	header.file_size_ = offset;
+	return header;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <vector>
+
+///*******************************************************************
+/// Simple helpers for thread parallel loops based on std::thread
+///*******************************************************************
+
+/// First index of chunk c if the index range [begin, end) is split into
+/// num_chunks contiguous chunks of (almost) equal size
+template<class I>
+inline I chunk_begin(I begin, I end, int num_chunks, int c) {
+	return begin + static_cast<I>((static_cast<long long>(end - begin) * c) / num_chunks);
+}
+
+/// Number of chunks actually used by parallel_for for the given range
+template<class I>
+inline int num_chunks(I begin, I end, int num_threads) {
+	if(num_threads > end - begin) {
+		num_threads = static_cast<int>(end - begin);
+	}
+	return num_threads < 1 ? 1 : num_threads;
+}
+
+/// Split the index range [begin, end) into num_chunks(begin, end, num_threads)
+/// contiguous chunks and call f(chunk_begin, chunk_end, c) for every chunk c
+/// on its own thread. The calling thread processes chunk 0. The splitting
+/// only depends on begin, end and num_threads, i.e. two calls with the same
+/// arguments process the same chunks.
+template<class I, class F>
+void parallel_for(I begin, I end, int num_threads, F f) {
+	const int n = num_chunks(begin, end, num_threads);
+	if(n == 1) {
+		f(begin, end, 0);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(n - 1);
+	for(int c = 1; c < n; ++c) {
+		threads.push_back(std::thread(f, chunk_begin(begin, end, n, c), chunk_begin(begin, end, n, c + 1), c));
+	}
+	f(begin, chunk_begin(begin, end, n, 1), 0);
+	for(int c = 0; c < n - 1; ++c) {
+		threads[c].join();
+	}
+}
+
+#endif
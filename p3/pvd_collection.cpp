@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+#include "pvd_collection.h"
+#include "io_util.h"
+
+static const char PVD_HEADER[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<VTKFile type=\"Collection\" version=\"0.1\">\n"
+	"<Collection>\n";
+
+static const char PVD_FOOTER[] =
+	"</Collection>\n"
+	"</VTKFile>\n";
+
+PvdCollection::PvdCollection()
+	: fd_(-1), shadow_fd_(-1), dir_fd_(-1), footer_offset_(0), shadow_footer_offset_(0) {
+}
+
+PvdCollection::~PvdCollection() {
+	close();
+}
+
+// Create filename with the given contents, synced to disk; returns the
+// file descriptor or -1
+static int create_synced(const std::string &filename, const std::string &contents) {
+	int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	if (!pwrite_all(fd, contents, 0) || fdatasync(fd) != 0) {
+		::close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int PvdCollection::open(const char* prefix) {
+	close();
+
+	prefix_ = prefix;
+	const std::string pvdfilename = prefix_ + ".pvd";
+	const std::string::size_type slash = prefix_.rfind('/');
+	const std::string dirname = slash == std::string::npos ? std::string(".") : prefix_.substr(0, slash + 1);
+	dir_fd_ = ::open(dirname.c_str(), O_RDONLY | O_DIRECTORY);
+	if (dir_fd_ < 0) {
+		printf("Could not open directory %s.\n", dirname.c_str());
+		return -1;
+	}
+
+	// both copies start as empty collection; prefix.pvd is replaced by
+	// rename, i.e. an old collection stays valid until then
+	const std::string empty = std::string(PVD_HEADER) + PVD_FOOTER;
+	footer_offset_ = shadow_footer_offset_ = sizeof(PVD_HEADER) - 1;
+	pending_.clear();
+	shadow_fd_ = create_synced(pvdfilename + ".shadow", empty);
+	fd_ = create_synced(pvdfilename + ".swap", empty);
+	if (fd_ < 0 || shadow_fd_ < 0
+	    || rename((pvdfilename + ".swap").c_str(), pvdfilename.c_str()) != 0 || fsync(dir_fd_) != 0) {
+		printf("Could not open %s for writing.\n", pvdfilename.c_str());
+		close();
+		return -1;
+	}
+	return 0;
+}
+
+void PvdCollection::close() {
+	if (shadow_fd_ >= 0) {
+		::close(shadow_fd_);
+		shadow_fd_ = -1;
+		unlink((prefix_ + ".pvd.shadow").c_str());
+	}
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+	if (dir_fd_ >= 0) {
+		::close(dir_fd_);
+		dir_fd_ = -1;
+	}
+}
+
+bool PvdCollection::swap_files() {
+	// prefix.pvd is replaced by the shadow file in one rename; the old
+	// pvd file gets the name of the shadow file via a temporary link
+	const std::string pvdfilename = prefix_ + ".pvd";
+	const std::string shadow = pvdfilename + ".shadow";
+	const std::string swap = pvdfilename + ".swap";
+	unlink(swap.c_str());
+	if (link(pvdfilename.c_str(), swap.c_str()) != 0
+	    || rename(shadow.c_str(), pvdfilename.c_str()) != 0
+	    || rename(swap.c_str(), shadow.c_str()) != 0
+	    || fsync(dir_fd_) != 0) {
+		return false;
+	}
+	std::swap(fd_, shadow_fd_);
+	std::swap(footer_offset_, shadow_footer_offset_);
+	return true;
+}
+
+int PvdCollection::append(const char* filename, double time) {
+	if (fd_ < 0) {
+		printf("No pvd file open.\n");
+		return -1;
+	}
+
+	char entry[1024];
+	int len = snprintf(entry, sizeof(entry), "<DataSet timestep=\"%e\" group=\"\" part=\"0\" file=\"%s\"/>\n", time, filename);
+	if (len < 0 || len >= static_cast<int>(sizeof(entry))) {
+		printf("File name %s is too long.\n", filename);
+		return -1;
+	}
+
+	// the shadow file gets the entry it lacks and the new one, which
+	// overwrite its old footer; it is complete on disk before it replaces
+	// the pvd file
+	const std::string entries = pending_ + std::string(entry, len);
+	if (!pwrite_all(shadow_fd_, entries + PVD_FOOTER, shadow_footer_offset_)
+	    || fdatasync(shadow_fd_) != 0) {
+		printf("Error while writing %s.pvd.shadow.\n", prefix_.c_str());
+		return -1;
+	}
+	shadow_footer_offset_ += entries.size();
+	pending_.assign(entry, len);
+
+	if (!swap_files()) {
+		printf("Error while replacing %s.pvd.\n", prefix_.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+int PvdCollection::write(
+	GRID &g,
+	FE_VEC u[],
+	int n_vectors,
+	int timestep,
+	double time,
+	const VtuOptions &options
+) {
+	const bool partitioned = options.num_pieces_ > 1;
+	const std::string filename = prefix_ + "_" + std::to_string(timestep) + (partitioned ? ".pvtu" : ".vtu");
+
+	int ret;
+	if (partitioned) {
+		ret = write_pvtu(g, u, n_vectors, const_cast<char*>(filename.c_str()), options);
+	} else {
+		ret = write_vtu(g, u, n_vectors, const_cast<char*>(filename.c_str()), options);
+	}
+	if (ret != 0) {
+		return ret;
+	}
+
+	// the data set is referenced only after it has been written completely
+	const std::string::size_type slash = filename.rfind('/');
+	return append(slash == std::string::npos ? filename.c_str() : filename.c_str() + slash + 1, time);
+}
@@ -0,0 +1,94 @@
+#ifndef _PVD_COLLECTION_H_
+#define _PVD_COLLECTION_H_
+
+#include <string>
+
+#include "grid.h"
+#include "FE_VEC.h"
+
+/// @brief Time series of vtu/pvtu files in a pvd file (use e.g. ParaView
+/// to view this file)
+/// The pvd file is updated atomically, i.e. prefix.pvd is a complete pvd
+/// file at any time, even after a crash: two copies of the collection are
+/// kept open, prefix.pvd and the shadow file prefix.pvd.shadow, which
+/// lacks the entry of the last time step. A new time step is written to
+/// the shadow file, which gets the missing entries and the footer at the
+/// position of its old footer, synced to disk and then swapped with
+/// prefix.pvd by rename. The effort per time step is thus independent of
+/// the number of time steps. The shadow file is removed by close().
+class PvdCollection {
+private:
+	/// File descriptors of the pvd file and of the shadow file, -1 if not
+	/// open
+	int fd_;
+	int shadow_fd_;
+
+	/// File descriptor of the directory of the pvd file, used to sync the
+	/// renames
+	int dir_fd_;
+
+	/// Prefix for the file names, see open()
+	std::string prefix_;
+
+	/// Position of the footer in the pvd file and in the shadow file
+	long footer_offset_;
+	long shadow_footer_offset_;
+
+	/// Entry contained in the pvd file but not yet in the shadow file
+	std::string pending_;
+
+	/// Swap pvd file and shadow file, see append()
+	bool swap_files();
+
+	PvdCollection(const PvdCollection&);
+	PvdCollection& operator=(const PvdCollection&);
+
+public:
+	/// Constructor, no file is opened
+	PvdCollection();
+
+	/// Destructor, closes the pvd file
+	~PvdCollection();
+
+	/// Create the pvd file prefix.pvd with an empty collection
+	/// An existing file is overwritten.
+	/// @param prefix prefix for the pvd file and the vtu files of the
+	/// time steps
+	/// @return 0 on success, -1 otherwise
+	int open(const char* prefix);
+
+	/// Close the pvd file and remove the shadow file
+	void close();
+
+	/// Check if the pvd file is open
+	bool is_open() const {
+		return fd_ >= 0;
+	}
+
+	/// Append data set file to the collection
+	/// @param filename file name relative to the directory of the pvd file
+	/// @param time (physical/simulated) time of the time-step
+	/// @return 0 on success, -1 otherwise
+	int append(const char* filename, double time);
+
+	/// Write out FE_VECs on GRID as time-step timestep to the vtu file
+	/// prefix_<timestep>.vtu (or pvtu file prefix_<timestep>.pvtu if
+	/// options.num_pieces_ > 1) and append it to the collection
+	/// @param g GRID on which the FE_VECs are defined
+	/// @param vectors FE_VECs which data shall be visualized
+	/// @param n_vectors length of vectors
+	/// @param timestep number of the time-step to be visualized
+	/// @param time (physical/simulated) time of the time-step
+	/// @param options output options of the vtu file, see write_vtu
+	/// @return 0 on success, -1 otherwise
+	int write(
+		GRID &g,
+		FE_VEC vectors[],
+		int n_vectors,
+		int timestep,
+		double time,
+		const VtuOptions &options = VtuOptions()
+	);
+};
+
+#endif
@@ -3,9 +3,12 @@
 #include "sys/time.h"
 #include <iostream>
 #include <assert.h>
+#include <algorithm>
 
 #include "grid.h"
 #include "FE_VEC.h"
+#include "grid_hierarchy.h"
+#include "async_writer.h"
 
 #include "exercise_sheet_2.h"
 #include "exercise_sheet_3.h"
@@ -16,87 +19,98 @@ int main(int argc, char *argv[]) {
 
 	timeval solstart, solende;
 	double start_s, end_s;
-	GRID *g[grids];
 
-	// On each grid level: 0 boundary_flag, 1 set Dirichlet boundary conditon
-	std::vector<FE_VEC*> values(grids);
-
-	std::vector<int> dirichlet_nodes;
-	std::vector<double> dirichlet_val;
+	// Hierarchy of GRIDs; only the levels which are currently needed are
+	// kept in memory
+	GridHierarchy h(grids, num_threads);
 
-	for(int i = 0; i < grids; ++i) {
-		g[i] = new GRID;
-		assert(g[i] != NULL);
-
-		values[i] = new FE_VEC[2];
-
-		values[i][0].setName((char*) "Boundary flag");
-		values[i][1].setName((char*) "Dirichlet BC");
+	// On each grid level: 0 boundary_flag, 1 set Dirichlet boundary conditon
+	FE_VEC values[2];
+	values[0].setName((char*) "Boundary flag");
+	values[1].setName((char*) "Dirichlet BC");
+
+	// Visualization output is written in the background while the next
+	// level is computed
+	PvdCollection pvd;
+	if (pvd.open("data/test") != 0) {
+		return -1;
 	}
-
-	// Initial GRID level
-	std::cout << "====================================================" << std::endl;
-	std::cout << "Level 0" << std::endl;
-	std::cout << "====================================================" << std::endl;
+	AsyncWriter writer;
+	// pieces are written concurrently, the remaining threads are used to
+	// compress the data of each piece
+	VtuOptions vtu_options(vtu_format, vtu_pieces, std::max(1, num_threads / vtu_pieces));
+	vtu_options.precision_ = vtu_precision;
+	vtu_options.quantization_tolerance_ = vtu_quantization_tolerance;
+	std::vector<std::future<int> > written;
+
+	std::vector<index_t> dirichlet_nodes;
+	std::vector<double> dirichlet_val;
 
 	// read initial grid from file
-	g[0]->read_from_file(coord_filename, conn_filename);
-
-	// prepare function values
-	values[0][1].resize(g[0]->num_nodes());
-
-	// get boundary flag
-	g[0]->boundary_flag_to_FE_VEC(values[0][0]);
-
-	// compute Dirichlet BC
-	gettimeofday(&solstart, NULL);
-	g[0]->compute_dirichlet_nodes_and_values(Dirichlet_BC_exercise_3, dirichlet_nodes, dirichlet_val);
-	gettimeofday(&solende, NULL);
+	h.read_from_file(coord_filename, conn_filename, bnd_filename);
 
-	start_s = solstart.tv_sec + solstart.tv_usec * 1.0e-6;
-	end_s = solende.tv_sec + solende.tv_usec * 1.0e-6;
-	std::cout << std::endl << "Computation of Dirichlet boundary conditions took " << end_s - start_s << " seconds." << std::endl;
-
-	values[0][1].setValues(dirichlet_val, dirichlet_nodes);
-
-	// refine grid grid-1 times and interpolate values to next level
-	for (int i = 1; i < grids; ++i) {
+	for (int i = 0; i < grids; ++i) {
 		std::cout << "====================================================" << std::endl;
 		std::cout << "Level " << i << std::endl;
 		std::cout << "====================================================" << std::endl;
-		// refine grid and interpolate values
-		gettimeofday(&solstart, NULL);
-		g[i-1]->refine_ip(NULL, 0, *g[i], NULL);
-		gettimeofday(&solende, NULL);
 
-		start_s = solstart.tv_sec + solstart.tv_usec * 1.0e-6;
-		end_s = solende.tv_sec + solende.tv_usec * 1.0e-6;
-		std::cout << std::endl << "The refinement from level " << i-1 << " to level " << i << " (including calculation of boundary_flag_) took " << end_s - start_s << " seconds." << std::endl;
+		if (i > 0) {
+			// refine grid
+			gettimeofday(&solstart, NULL);
+			h.level(i);
+			gettimeofday(&solende, NULL);
+
+			start_s = solstart.tv_sec + solstart.tv_usec * 1.0e-6;
+			end_s = solende.tv_sec + solende.tv_usec * 1.0e-6;
+			std::cout << std::endl << "The refinement from level " << i-1 << " to level " << i << " (including calculation of boundary_flag_) took " << end_s - start_s << " seconds." << std::endl;
+		}
 
-		std::cout << "Number of nodes on level " << i <<": " << g[i]->num_nodes() << std::endl;
-		std::cout << "Number of triangles on level " << i << ": " << g[i]->num_triangles() << std::endl;
+		GRID &g = h.level(i);
+		if (i > 0) {
+			std::cout << "Number of nodes on level " << i <<": " << g.num_nodes() << std::endl;
+			std::cout << "Number of triangles on level " << i << ": " << g.num_triangles() << std::endl;
+		}
 
-		// prepare function values on new grid level
-		values[i][1].resize(g[i]->num_nodes());
+		// prepare function values on this grid level
+		values[1].resize(0);
+		values[1].resize(g.num_nodes());
 
 		// get boundary flag
-		g[i]->boundary_flag_to_FE_VEC(values[i][0]);
+		g.boundary_flag_to_FE_VEC(values[0]);
 
-		// compute Dirichlet BC
+		// compute Dirichlet BC; on finer levels, they are derived from the
+		// ones on the coarser level and only the new nodes are evaluated
 		gettimeofday(&solstart, NULL);
-		g[i]->compute_dirichlet_nodes_and_values(Dirichlet_BC_exercise_3, dirichlet_nodes, dirichlet_val);
+		if (i == 0) {
+			g.compute_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), dirichlet_nodes, dirichlet_val);
+		} else {
+			if (!h.level(i-1).refine_dirichlet_bc(dirichlet_tags, DirichletValuesExercise3(), g, dirichlet_nodes, dirichlet_val)) {
+				return -1;
+			}
+		}
 		gettimeofday(&solende, NULL);
 
 		start_s = solstart.tv_sec + solstart.tv_usec * 1.0e-6;
 		end_s = solende.tv_sec + solende.tv_usec * 1.0e-6;
 		std::cout << std::endl << "Computation of Dirichlet boundary conditions took " << end_s - start_s << " seconds." << std::endl;
-		
-		values[i][1].setValues(dirichlet_val, dirichlet_nodes);
+
+		values[1].setValues(dirichlet_val, dirichlet_nodes);
+
+		// the coarser level is not needed anymore; the coarsest level is
+		// always kept by the hierarchy
+		if (i > 1) {
+			h.release(i-1);
+		}
+
+		// Visualize the results
+		written.push_back(writer.write(pvd, h.level_handle(i), values, 2, i, i, vtu_options));
 	}
 
-	// Visualize the results
 	for (int i = 0; i < grids; ++i) {
-		write_pvd(*g[i], values[i], 2, (char*) "data/test", i, i);
+		if (written[i].get() != 0) {
+			std::cout << "Output of level " << i << " failed." << std::endl;
+			return -1;
+		}
 	}
 
  	return 0;
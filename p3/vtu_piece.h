@@ -0,0 +1,38 @@
+#ifndef _VTU_PIECE_H_
+#define _VTU_PIECE_H_
+
+#include "grid.h"
+
+///*******************************************************************
+/// Internal interface of the vtu writers, see write_vtu.cpp
+///*******************************************************************
+
+/// @brief Raw data of one piece of a vtu file, i.e. a GRID or a part of
+/// it together with point data. No data is owned by the piece.
+struct VtuPiece {
+	/// Number of nodes
+	count_t num_nodes;
+	/// Coordinates of the nodes, coords[d][i] is coordinate d of node i
+	const double *coords[NDIM];
+	/// Number of triangles
+	count_t num_triangles;
+	/// Triangles with vertices numbered wrt. the nodes of the piece
+	const Triangle *triangles;
+	/// Number of point data arrays
+	int n_vectors;
+	/// Point data arrays of length num_nodes
+	const double *const *values;
+	/// Names of the point data arrays
+	const char *const *names;
+};
+
+/// Type of the floating point DataArrays written with options
+inline const char* vtu_float_type(const VtuOptions &options) {
+	return (options.format_ != VTU_ASCII && options.precision_ == VTU_FLOAT32) ? "Float32" : "Float64";
+}
+
+/// Write piece to vtu file name
+/// @return 0 on success, -1 otherwise
+int write_vtu_piece(const VtuPiece &piece, const char* name, const VtuOptions &options);
+
+#endif
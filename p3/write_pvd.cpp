@@ -24,7 +24,8 @@ int write_pvd(
 	int n_vectors,	// no of fe vectors
 	char* prefix,		// prefix for filenames
 	int	timestep,		// number of timestep
-	double time			// current time
+	double time,			// current time
+	const VtuOptions &options
 ) {
 	// Create filename
 	FILE *fp;
@@ -37,9 +38,11 @@ int write_pvd(
 	filename_len = strlen(prefix) + 7 + floor( log( (double) timestep ) / log(10.0) );
 	if (timestep == 0) filename_len = strlen(prefix)+7;
 
-	filename = (char*) calloc(filename_len, sizeof(char));
+	// one more character for ".pvtu"
+	filename = (char*) calloc(filename_len + 1, sizeof(char));
 
-	sprintf(filename, "%s_%d.vtu",prefix,timestep);
+	const bool partitioned = options.num_pieces_ > 1;
+	sprintf(filename, partitioned ? "%s_%d.pvtu" : "%s_%d.vtu",prefix,timestep);
 	sprintf(pvdfilename, "%s.pvd",prefix);
 
 	// First call
@@ -68,5 +71,8 @@ int write_pvd(
 	}
 	fclose(fp);
 
-	return write_vtu(g, u, n_vectors, filename);
+	if (partitioned) {
+		return write_pvtu(g, u, n_vectors, filename, options);
+	}
+	return write_vtu(g, u, n_vectors, filename, options);
 }
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "grid.h"
+#include "vtu_piece.h"
+#include "parallel.h"
+
+// Write piece p of g to file name, see write_pvtu
+static int write_pvtu_piece(GRID &g, FE_VEC u[], int n_vectors, const char* name,
+                            const VtuOptions &options, index_t tri_begin, index_t tri_end) {
+
+	const count_t nt = tri_end - tri_begin;
+	const Triangle *triangles = g.triangles() + tri_begin;
+
+	// nodes of the piece in ascending order; the local number of a node
+	// is its position in nodes
+	std::vector<index_t> nodes(NODES_PER_TRIANGLE * nt);
+	for(count_t i = 0; i < nt; i++) {
+		for(int j = 0; j < NODES_PER_TRIANGLE; j++) {
+			nodes[NODES_PER_TRIANGLE * i + j] = triangles[i][j];
+		}
+	}
+	std::sort(nodes.begin(), nodes.end());
+	nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+	const count_t nn = nodes.size();
+
+	std::vector<Triangle> local_triangles(nt);
+	for(count_t i = 0; i < nt; i++) {
+		for(int j = 0; j < NODES_PER_TRIANGLE; j++) {
+			local_triangles[i][j] = std::lower_bound(nodes.begin(), nodes.end(), triangles[i][j]) - nodes.begin();
+		}
+	}
+
+	std::vector<double> coords[NDIM];
+	for(int d = 0; d < NDIM; d++) {
+		const double *c = g.coordinates(d);
+		coords[d].resize(nn);
+		for(count_t i = 0; i < nn; i++) {
+			coords[d][i] = c[nodes[i]];
+		}
+	}
+
+	std::vector<std::vector<double> > values(n_vectors);
+	std::vector<const double*> values_ptr(n_vectors);
+	std::vector<const char*> names(n_vectors);
+	for(int k = 0; k < n_vectors; k++) {
+		values[k].resize(nn);
+		for(count_t i = 0; i < nn; i++) {
+			values[k][i] = u[k][nodes[i]];
+		}
+		values_ptr[k] = values[k].data();
+		names[k] = u[k].getName();
+	}
+
+	VtuPiece piece;
+	piece.num_nodes = nn;
+	for(int d = 0; d < NDIM; d++) {
+		piece.coords[d] = coords[d].data();
+	}
+	piece.num_triangles = nt;
+	piece.triangles = local_triangles.data();
+	piece.n_vectors = n_vectors;
+	piece.values = values_ptr.data();
+	piece.names = names.data();
+
+	return write_vtu_piece(piece, name, options);
+}
+
+int write_pvtu(
+	GRID &g,					// grid
+	FE_VEC u[], 		// fe vectors
+	int n_vectors,	// no of fe vectors
+	char* name,		// filename of the pvtu file
+	const VtuOptions &options
+) {
+	for(int k = 0; k < n_vectors; k++) {
+		if (g.num_nodes() != u[k].length()) {
+			std::cout << "Grid (" << g.num_nodes() << " nodes) and fe vector " << k << " (length " << u[k].length() << ") do not match!" << std::endl;
+			return -1;
+		}
+	}
+
+	const std::string pvtu_name(name);
+	const std::string suffix(".pvtu");
+	if (pvtu_name.size() < suffix.size() || pvtu_name.compare(pvtu_name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+		printf("Filename %s does not end with %s.\n", name, suffix.c_str());
+		return -1;
+	}
+	// prefix of the pieces with and without directory
+	const std::string prefix = pvtu_name.substr(0, pvtu_name.size() - suffix.size());
+	const std::string::size_type slash = prefix.rfind('/');
+	const std::string base = slash == std::string::npos ? prefix : prefix.substr(slash + 1);
+
+	// every piece has at least one triangle
+	const index_t nt = g.num_triangles();
+	const int num_pieces = num_chunks(index_t(0), nt, options.num_pieces_);
+
+	std::vector<std::string> piece_names(num_pieces);
+	for(int p = 0; p < num_pieces; p++) {
+		piece_names[p] = prefix + "_" + std::to_string(p) + ".vtu";
+	}
+
+	std::vector<int> ret(num_pieces, 0);
+	parallel_for(index_t(0), nt, num_pieces, [&](index_t begin, index_t end, int p) {
+		ret[p] = write_pvtu_piece(g, u, n_vectors, piece_names[p].c_str(), options, begin, end);
+	});
+	for(int p = 0; p < num_pieces; p++) {
+		if (ret[p] != 0) {
+			return -1;
+		}
+	}
+
+	FILE *fp;
+	if ((fp = fopen(name, "w")) == NULL) {
+		printf("Could not open %s for writing.\n", name);
+		return -1;
+	}
+
+	fprintf(fp,"<?xml version=\"1.0\" ?>\n");
+	fprintf(fp,"<VTKFile type=\"PUnstructuredGrid\" version=\"0.1\">\n");
+	fprintf(fp,"\t<PUnstructuredGrid GhostLevel=\"0\">\n");
+	if (n_vectors > 0) {
+		fprintf(fp,"\t\t<PPointData Scalars=\"%s\">\n", u[0].getName());
+		for(int k = 0; k < n_vectors; k++) {
+			fprintf(fp,"\t\t\t<PDataArray Name=\"%s\" type=\"%s\"/>\n", u[k].getName(), vtu_float_type(options));
+		}
+		fprintf(fp,"\t\t</PPointData>\n");
+	}
+	fprintf(fp,"\t\t<PPoints>\n");
+	fprintf(fp,"\t\t\t<PDataArray type=\"%s\" Name=\"Array\" NumberOfComponents=\"3\"/>\n", vtu_float_type(options));
+	fprintf(fp,"\t\t</PPoints>\n");
+	for(int p = 0; p < num_pieces; p++) {
+		fprintf(fp,"\t\t<Piece Source=\"%s_%d.vtu\"/>\n", base.c_str(), p);
+	}
+	fprintf(fp,"\t</PUnstructuredGrid>\n");
+	fprintf(fp,"</VTKFile>\n");
+
+	fclose(fp);
+	return 0;
+}
@@ -1,42 +1,44 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
 #include "grid.h"
+#include "vtu_piece.h"
+#include "parallel.h"
+#include "io_util.h"
 
-int write_vtu(
-	GRID &g,						// a grid
-	FE_VEC u[],				// fe vectors
-	int n_vectors,		// no of fe vectors
-	char* name				// filename to write to, will overwrite w/o warning
-){
+#include <zlib.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
-	int i,j; // counter
-	FILE *fp;
+// Uncompressed size of the blocks of compressed DataArrays in bytes
+static const uint64_t VTU_COMPRESSION_BLOCK_SIZE = 1 << 16;
+
+// Write the DataArrays in ascii format
+static void write_vtu_ascii(const VtuPiece &p, FILE *fp) {
+
+	count_t i,j; // counter
+	const int n_vectors = p.n_vectors;
 
-	for(i = 0; i < n_vectors; i++) {
-		if (g.num_nodes() != u[i].length()) {
-			std::cout << "Grid (" << g.num_nodes() << " nodes) and fe vector " << i << " (length " << u[i].length() << ") do not match!" << std::endl;
-			return -1;
-		}
-	}
- 
-	if ((fp = fopen(name, "w")) == NULL) {
-		printf("Could not open %s for writing.\n", name);
-		return -1;
-	}
-	
 	// vtk-header
 	fprintf(fp,"<?xml version=\"1.0\" ?>\n");
   	fprintf(fp,"<VTKFile type=\"UnstructuredGrid\" version=\"0.1\">\n");
  	fprintf(fp,"\t<UnstructuredGrid>\n");
-    fprintf(fp,"\t\t<Piece NumberOfPoints=\"%d\" ",g.num_nodes());
-	fprintf(fp,"NumberOfCells=\"%d\">\n",g.num_triangles());
+    fprintf(fp,"\t\t<Piece NumberOfPoints=\"%ld\" ",static_cast<long>(p.num_nodes));
+	fprintf(fp,"NumberOfCells=\"%ld\">\n",static_cast<long>(p.num_triangles));
 	
 	if (n_vectors > 0) {
-		fprintf(fp,"\t\t\t<PointData Scalars=\"%s\">\n", u[0].getName());
-		for(i = 0; i < n_vectors; i++) {
+		fprintf(fp,"\t\t\t<PointData Scalars=\"%s\">\n", p.names[0]);
+		for(int k = 0; k < n_vectors; k++) {
 			// vtk-Pointdata
-			fprintf(fp,"\t\t\t\t<DataArray Name=\"%s\" type=\"Float64\" format=\"ascii\">\n", u[i].getName());
-                        for(j = 0; j < g.num_nodes(); j++){
-				fprintf(fp,"\t\t\t\t\t%lf\n",u[i][j]);
+			fprintf(fp,"\t\t\t\t<DataArray Name=\"%s\" type=\"Float64\" format=\"ascii\">\n", p.names[k]);
+                        for(j = 0; j < p.num_nodes; j++){
+				fprintf(fp,"\t\t\t\t\t%lf\n",p.values[k][j]);
 			}
 			fprintf(fp,"\t\t\t\t</DataArray>\n");
 		}
@@ -51,26 +53,28 @@ int write_vtu(
 	fprintf(fp,"\t\t\t<Points>\n");
 	// for paraview, everything has to be 3d, even if it is 2d
 	fprintf(fp,"\t\t\t\t<DataArray type=\"Float64\" Name=\"Array\" NumberOfComponents=\"3\" format=\"ascii\">\n");
-        for(i = 0; i < g.num_nodes(); i++){
-          fprintf(fp,"\t\t\t\t\t%lf %lf %lf \n", g.get_coordinates(i)[0], g.get_coordinates(i)[1], 0.0);
+	const double *x = p.coords[0];
+	const double *y = p.coords[1];
+        for(i = 0; i < p.num_nodes; i++){
+          fprintf(fp,"\t\t\t\t\t%lf %lf %lf \n", x[i], y[i], 0.0);
 	}
 	fprintf(fp,"\t\t\t\t</DataArray>\n\t\t\t</Points>\n");
 
   	// vtk-Cells = triangs.
 	fprintf(fp,"\t\t\t<Cells>\n");
 	fprintf(fp,"\t\t\t\t<DataArray type=\"Int64\" Name=\"connectivity\" format=\"ascii\">\n");
-        for(i = 0; i < g.num_triangles(); i++){
+        for(i = 0; i < p.num_triangles; i++){
 		fprintf(fp,"\t\t\t\t\t%ld %ld %ld \n",
-                        static_cast<long>(g.get_triangle(i)[0]), static_cast<long>(g.get_triangle(i)[1]), static_cast<long>(g.get_triangle(i)[2]));
+                        static_cast<long>(p.triangles[i][0]), static_cast<long>(p.triangles[i][1]), static_cast<long>(p.triangles[i][2]));
 	}
 	fprintf(fp,"\t\t\t\t</DataArray>\n");
 	fprintf(fp,"\t\t\t\t<DataArray type=\"Int64\" Name=\"offsets\" format=\"ascii\">\n");
-        for(i = 0; i < g.num_triangles(); i++){
-		fprintf(fp,"\t\t\t\t\t%ld \n", static_cast<long>((i+1)*NODES_PER_TRIANGLE));
+        for(i = 0; i < p.num_triangles; i++){
+		fprintf(fp,"\t\t\t\t\t%ld \n", static_cast<long>(i+1)*NODES_PER_TRIANGLE);
 	}
 	fprintf(fp,"\t\t\t\t</DataArray>\n");
 	fprintf(fp,"\t\t\t\t<DataArray type=\"UInt8\" Name=\"types\" format=\"ascii\">\n");
-        for(i = 0; i < g.num_triangles(); i++){
+        for(i = 0; i < p.num_triangles; i++){
 		fprintf(fp,"\t\t\t\t\t%d \n", 5);
 	}
 	fprintf(fp,"\t\t\t\t</DataArray>\n");
@@ -81,6 +85,374 @@ int write_vtu(
 	fprintf(fp,"\t</UnstructuredGrid>\n");
 	fprintf(fp,"</VTKFile>\n");
 
+}
+
+// Block of the AppendedData section
+struct AppendedBlock {
+	const void *data;
+	uint64_t size;	// in bytes
+	// header and compressed data, only used for compressed formats
+	std::vector<unsigned char> encoded;
+};
+
+// Compress one block of size bytes into out, which has to be large
+// enough, see compress_bound. Returns the compressed size.
+static uint64_t compress_block(const unsigned char *data, uint64_t size, unsigned char *out, uint64_t out_size,
+                               const VtuOptions &options) {
+#ifdef HAVE_LZ4
+	if (options.format_ == VTU_APPENDED_LZ4) {
+		return LZ4_compress_default(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(out),
+		                            static_cast<int>(size), static_cast<int>(out_size));
+	}
+#endif
+	uLongf len = out_size;
+	if (compress2(out, &len, data, size, options.compression_level_) != Z_OK) {
+		return 0;
+	}
+	return len;
+}
+
+// Upper bound for the compressed size of a block of size bytes
+static uint64_t compress_bound(uint64_t size, const VtuOptions &options) {
+#ifdef HAVE_LZ4
+	if (options.format_ == VTU_APPENDED_LZ4) {
+		return LZ4_compressBound(static_cast<int>(size));
+	}
+#endif
+	return compressBound(size);
+}
+
+// Compress b.data in blocks of VTU_COMPRESSION_BLOCK_SIZE bytes in the
+// format of vtkDataCompressor with UInt64 header, i.e.
+// [#blocks][block size][size of last block if partial, else 0]
+// [compressed size of block 0]...[compressed size of block #blocks-1]
+// followed by the compressed blocks. The blocks are compressed in
+// parallel. Returns false if compression fails.
+static bool encode_block(AppendedBlock &b, const VtuOptions &options) {
+	const uint64_t num = (b.size + VTU_COMPRESSION_BLOCK_SIZE - 1) / VTU_COMPRESSION_BLOCK_SIZE;
+	const uint64_t bound = compress_bound(VTU_COMPRESSION_BLOCK_SIZE, options);
+	const unsigned char *data = static_cast<const unsigned char*>(b.data);
+
+	std::vector<unsigned char> compressed(num * bound);
+	std::vector<uint64_t> header(3 + num);
+	header[0] = num;
+	header[1] = VTU_COMPRESSION_BLOCK_SIZE;
+	header[2] = b.size % VTU_COMPRESSION_BLOCK_SIZE;
+
+	parallel_for(count_t(0), static_cast<count_t>(num), options.num_threads_, [&](count_t begin, count_t end, int) {
+		for(count_t i = begin; i < end; i++) {
+			const uint64_t size = std::min(VTU_COMPRESSION_BLOCK_SIZE, b.size - i * VTU_COMPRESSION_BLOCK_SIZE);
+			header[3 + i] = compress_block(data + i * VTU_COMPRESSION_BLOCK_SIZE, size,
+			                               compressed.data() + i * bound, bound, options);
+		}
+	});
+
+	uint64_t total = header.size() * sizeof(uint64_t);
+	for(uint64_t i = 0; i < num; i++) {
+		if (header[3 + i] == 0) {
+			return false;
+		}
+		total += header[3 + i];
+	}
+
+	b.encoded.resize(total);
+	unsigned char *out = b.encoded.data();
+	memcpy(out, header.data(), header.size() * sizeof(uint64_t));
+	out += header.size() * sizeof(uint64_t);
+	for(uint64_t i = 0; i < num; i++) {
+		memcpy(out, compressed.data() + i * bound, header[3 + i]);
+		out += header[3 + i];
+	}
+	return true;
+}
+
+// Round value to as few mantissa bits as possible such that the absolute
+// error is at most 2^tolerance_exp; values with smaller magnitude become 0
+template<class F>
+static F quantize(F value, int tolerance_exp) {
+	typedef typename std::conditional<sizeof(F) == 4, uint32_t, uint64_t>::type U;
+	const int mantissa_bits = std::numeric_limits<F>::digits - 1;
+
+	if (!std::isfinite(value)) {
+		return value;
+	}
+	if (std::ilogb(value) < tolerance_exp) {
+		return 0;
+	}
+	// |value| is in [2^e, 2^(e+1)), clearing n bits gives a step of
+	// 2^(e-mantissa_bits+n), i.e. an error of half of it after rounding
+	const int n = std::min(tolerance_exp - std::ilogb(value) + mantissa_bits + 1, mantissa_bits);
+	if (n <= 0) {
+		return value;
+	}
+	U bits;
+	memcpy(&bits, &value, sizeof(F));
+	// round to nearest, a carry into the exponent is correct
+	bits = (bits + (U(1) << (n - 1))) & ~((U(1) << n) - 1);
+	memcpy(&value, &bits, sizeof(F));
+	return value;
+}
+
+// Copy the array x of length n to out as type F and quantize it if
+// tolerance is positive, see VtuOptions::quantization_tolerance_
+template<class F>
+static void convert_values(const double *x, count_t n, double tolerance, int num_threads, std::vector<F> &out) {
+	out.resize(n);
+	const int tolerance_exp = tolerance > 0 ? std::ilogb(tolerance) : 0;
+	parallel_for(count_t(0), n, num_threads, [&](count_t begin, count_t end, int) {
+		for(count_t i = begin; i < end; i++) {
+			out[i] = static_cast<F>(x[i]);
+			if (tolerance > 0) {
+				out[i] = quantize(out[i], tolerance_exp);
+			}
+		}
+	});
+}
+
+// Write the DataArrays as raw binary data in the AppendedData section.
+// Each block is preceded by its size as UInt64 and written by a single
+// fwrite; the offset attribute of a DataArray is the position of its
+// block relative to the first byte after the '_' marker.
+static int write_vtu_appended(const VtuPiece &p, FILE *fp, const VtuOptions &options) {
+
+	const count_t nn = p.num_nodes;
+	const count_t nt = p.num_triangles;
+	const int n_vectors = p.n_vectors;
+
+	const bool single = options.precision_ == VTU_FLOAT32;
+	const double tolerance = options.quantization_tolerance_;
+
+	// point data, converted to Float32 or quantized if requested
+	std::vector<std::vector<float> > values_float(single ? n_vectors : 0);
+	std::vector<std::vector<double> > values_double(!single && tolerance > 0 ? n_vectors : 0);
+	for(int k = 0; k < n_vectors; k++) {
+		if (single) {
+			convert_values(p.values[k], nn, tolerance, options.num_threads_, values_float[k]);
+		} else if (tolerance > 0) {
+			convert_values(p.values[k], nn, tolerance, options.num_threads_, values_double[k]);
+		}
+	}
+
+	// for paraview, everything has to be 3d, even if it is 2d
+	std::vector<double> points(single ? 0 : 3 * nn);
+	std::vector<float> points_float(single ? 3 * nn : 0);
+	const double *x = p.coords[0];
+	const double *y = p.coords[1];
+	for(count_t i = 0; i < nn; i++) {
+		if (single) {
+			points_float[3*i] = static_cast<float>(x[i]);
+			points_float[3*i+1] = static_cast<float>(y[i]);
+			points_float[3*i+2] = 0.0f;
+		} else {
+			points[3*i] = x[i];
+			points[3*i+1] = y[i];
+			points[3*i+2] = 0.0;
+		}
+	}
+
+	// the vertex numbers are written as they are stored in the GRID unless
+	// they can be narrowed to Int32
+	const bool conn_int32 = sizeof(index_t) == 4 || (single && nn <= std::numeric_limits<int32_t>::max());
+	std::vector<int32_t> conn;
+	if (sizeof(index_t) != 4 && conn_int32) {
+		conn.resize(NODES_PER_TRIANGLE * nt);
+		for(count_t i = 0; i < nt; i++) {
+			for(int j = 0; j < NODES_PER_TRIANGLE; j++) {
+				conn[NODES_PER_TRIANGLE*i+j] = static_cast<int32_t>(p.triangles[i][j]);
+			}
+		}
+	}
+
+	const bool offsets_int32 = single && NODES_PER_TRIANGLE * nt <= std::numeric_limits<int32_t>::max();
+	std::vector<int64_t> offsets(offsets_int32 ? 0 : nt);
+	std::vector<int32_t> offsets_short(offsets_int32 ? nt : 0);
+	for(count_t i = 0; i < nt; i++) {
+		if (offsets_int32) {
+			offsets_short[i] = static_cast<int32_t>((i+1) * NODES_PER_TRIANGLE);
+		} else {
+			offsets[i] = (i+1) * NODES_PER_TRIANGLE;
+		}
+	}
+	std::vector<uint8_t> types(nt, 5);
+
+	// blocks in order of their DataArrays
+	std::vector<AppendedBlock> blocks;
+	for(int k = 0; k < n_vectors; k++) {
+		AppendedBlock b = {p.values[k], static_cast<uint64_t>(nn * sizeof(double))};
+		if (single) {
+			b.data = values_float[k].data();
+			b.size = nn * sizeof(float);
+		} else if (tolerance > 0) {
+			b.data = values_double[k].data();
+		}
+		blocks.push_back(b);
+	}
+	AppendedBlock b_points = {points.data(), static_cast<uint64_t>(points.size() * sizeof(double))};
+	if (single) {
+		b_points.data = points_float.data();
+		b_points.size = points_float.size() * sizeof(float);
+	}
+	AppendedBlock b_conn = {p.triangles, static_cast<uint64_t>(nt * sizeof(Triangle))};
+	if (!conn.empty()) {
+		b_conn.data = conn.data();
+		b_conn.size = conn.size() * sizeof(int32_t);
+	}
+	AppendedBlock b_offsets = {offsets.data(), static_cast<uint64_t>(nt * sizeof(int64_t))};
+	if (offsets_int32) {
+		b_offsets.data = offsets_short.data();
+		b_offsets.size = nt * sizeof(int32_t);
+	}
+	AppendedBlock b_types = {types.data(), static_cast<uint64_t>(nt)};
+	blocks.push_back(b_points);
+	blocks.push_back(b_conn);
+	blocks.push_back(b_offsets);
+	blocks.push_back(b_types);
+
+	const bool compressed = options.format_ != VTU_APPENDED_RAW;
+	if (compressed) {
+		for(size_t k = 0; k < blocks.size(); k++) {
+			if (!encode_block(blocks[k], options)) {
+				printf("Compression of vtu data failed.\n");
+				return -1;
+			}
+		}
+	}
+
+	std::vector<uint64_t> block_offset(blocks.size());
+	uint64_t offset = 0;
+	for(size_t k = 0; k < blocks.size(); k++) {
+		block_offset[k] = offset;
+		offset += compressed ? blocks[k].encoded.size() : sizeof(uint64_t) + blocks[k].size;
+	}
+
+	const char *float_type = vtu_float_type(options);
+	const char *index_type = conn_int32 ? "Int32" : "Int64";
+	const char *offsets_type = offsets_int32 ? "Int32" : "Int64";
+
+	fprintf(fp,"<?xml version=\"1.0\" ?>\n");
+	fprintf(fp,"<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"",
+	        is_little_endian() ? "LittleEndian" : "BigEndian");
+	if (compressed) {
+		fprintf(fp," compressor=\"%s\"",
+		        options.format_ == VTU_APPENDED_LZ4 ? "vtkLZ4DataCompressor" : "vtkZLibDataCompressor");
+	}
+	fprintf(fp,">\n");
+	fprintf(fp,"\t<UnstructuredGrid>\n");
+	fprintf(fp,"\t\t<Piece NumberOfPoints=\"%ld\" NumberOfCells=\"%ld\">\n", static_cast<long>(nn), static_cast<long>(nt));
+
+	if (n_vectors > 0) {
+		fprintf(fp,"\t\t\t<PointData Scalars=\"%s\">\n", p.names[0]);
+		for(int k = 0; k < n_vectors; k++) {
+			fprintf(fp,"\t\t\t\t<DataArray Name=\"%s\" type=\"%s\" format=\"appended\" offset=\"%lu\"/>\n",
+			        p.names[k], float_type, static_cast<unsigned long>(block_offset[k]));
+		}
+		fprintf(fp,"\t\t\t</PointData>\n");
+	} else {
+		fprintf(fp,"\t\t\t<PointData />\n");
+	}
+	fprintf(fp,"\t\t\t<CellData />\n");
+
+	fprintf(fp,"\t\t\t<Points>\n");
+	fprintf(fp,"\t\t\t\t<DataArray type=\"%s\" Name=\"Array\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%lu\"/>\n",
+	        float_type, static_cast<unsigned long>(block_offset[n_vectors]));
+	fprintf(fp,"\t\t\t</Points>\n");
+
+	fprintf(fp,"\t\t\t<Cells>\n");
+	fprintf(fp,"\t\t\t\t<DataArray type=\"%s\" Name=\"connectivity\" format=\"appended\" offset=\"%lu\"/>\n",
+	        index_type, static_cast<unsigned long>(block_offset[n_vectors+1]));
+	fprintf(fp,"\t\t\t\t<DataArray type=\"%s\" Name=\"offsets\" format=\"appended\" offset=\"%lu\"/>\n",
+	        offsets_type, static_cast<unsigned long>(block_offset[n_vectors+2]));
+	fprintf(fp,"\t\t\t\t<DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"%lu\"/>\n",
+	        static_cast<unsigned long>(block_offset[n_vectors+3]));
+	fprintf(fp,"\t\t\t</Cells>\n");
+
+	fprintf(fp,"\t\t</Piece>\n");
+	fprintf(fp,"\t</UnstructuredGrid>\n");
+
+	fprintf(fp,"\t<AppendedData encoding=\"raw\">\n_");
+	for(size_t k = 0; k < blocks.size(); k++) {
+		if (compressed) {
+			fwrite(blocks[k].encoded.data(), 1, blocks[k].encoded.size(), fp);
+		} else {
+			fwrite(&blocks[k].size, sizeof(uint64_t), 1, fp);
+			fwrite(blocks[k].data, 1, blocks[k].size, fp);
+		}
+	}
+	fprintf(fp,"\n\t</AppendedData>\n");
+	fprintf(fp,"</VTKFile>\n");
+	return 0;
+}
+
+
+int write_vtu_piece(const VtuPiece &piece, const char* name, const VtuOptions &options) {
+
+	FILE *fp;
+	int ret = 0;
+
+#ifndef HAVE_LZ4
+	if (options.format_ == VTU_APPENDED_LZ4) {
+		printf("LZ4 compression is not available, compile with -DHAVE_LZ4.\n");
+		return -1;
+	}
+#endif
+
+	if ((fp = fopen(name, "wb")) == NULL) {
+		printf("Could not open %s for writing.\n", name);
+		return -1;
+	}
+	
+	switch(options.format_) {
+	case VTU_APPENDED_RAW:
+	case VTU_APPENDED_ZLIB:
+	case VTU_APPENDED_LZ4:
+		ret = write_vtu_appended(piece, fp, options);
+		break;
+	default:
+		write_vtu_ascii(piece, fp);
+		break;
+	}
+
+	if (ret != 0 || ferror(fp)) {
+		printf("Error while writing %s.\n", name);
+		fclose(fp);
+		return -1;
+	}
 	fclose(fp);
 	return 0;
 }
+
+int write_vtu(
+	GRID &g,						// a grid
+	FE_VEC u[],				// fe vectors
+	int n_vectors,		// no of fe vectors
+	char* name,				// filename to write to, will overwrite w/o warning
+	const VtuOptions &options
+){
+
+	for(int k = 0; k < n_vectors; k++) {
+		if (g.num_nodes() != u[k].length()) {
+			std::cout << "Grid (" << g.num_nodes() << " nodes) and fe vector " << k << " (length " << u[k].length() << ") do not match!" << std::endl;
+			return -1;
+		}
+	}
+
+	std::vector<const double*> values(n_vectors);
+	std::vector<const char*> names(n_vectors);
+	for(int k = 0; k < n_vectors; k++) {
+		values[k] = u[k].getValues().data();
+		names[k] = u[k].getName();
+	}
+
+	VtuPiece piece;
+	piece.num_nodes = g.num_nodes();
+	for(int d = 0; d < NDIM; ++d) {
+		piece.coords[d] = g.coordinates(d);
+	}
+	piece.num_triangles = g.num_triangles();
+	piece.triangles = g.triangles();
+	piece.n_vectors = n_vectors;
+	piece.values = values.data();
+	piece.names = names.data();
+
+	return write_vtu_piece(piece, name, options);
+}
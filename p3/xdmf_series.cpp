@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+#include "xdmf_series.h"
+#include "io_util.h"
+
+static const char XDMF_HEADER[] =
+	"<?xml version=\"1.0\" ?>\n"
+	"<Xdmf Version=\"3.0\">\n"
+	"<Domain>\n"
+	"<Grid Name=\"TimeSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+
+static const char XDMF_FOOTER[] =
+	"</Grid>\n"
+	"</Domain>\n"
+	"</Xdmf>\n";
+
+// Write size bytes of data to a new file filename
+static int write_heavy_data(const std::string &filename, const void *data, size_t size) {
+	FILE *fp;
+	if ((fp = fopen(filename.c_str(), "wb")) == NULL) {
+		printf("Could not open %s for writing.\n", filename.c_str());
+		return -1;
+	}
+	if ((size > 0 && fwrite(data, 1, size, fp) != size) || fclose(fp) != 0) {
+		printf("Error while writing %s.\n", filename.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+// DataItem referencing a raw binary heavy data file
+static void data_item(std::ostringstream &xml, const char* indent, const std::string &dimensions,
+                      const char* number_type, int precision, const std::string &filename, size_t seek) {
+	xml << indent << "<DataItem Dimensions=\"" << dimensions << "\" NumberType=\"" << number_type
+	    << "\" Precision=\"" << precision << "\" Format=\"Binary\" Endian=\""
+	    << (is_little_endian() ? "Little" : "Big") << "\" Seek=\"" << seek << "\">"
+	    << filename << "</DataItem>\n";
+}
+
+XdmfSeries::XdmfSeries()
+	: fd_(-1), footer_offset_(0), mesh_(-1), num_nodes_(0), num_triangles_(0), num_steps_(0) {
+}
+
+XdmfSeries::~XdmfSeries() {
+	close();
+}
+
+int XdmfSeries::open(const char* prefix) {
+	close();
+
+	prefix_ = prefix;
+	const std::string::size_type slash = prefix_.rfind('/');
+	base_ = slash == std::string::npos ? prefix_ : prefix_.substr(slash + 1);
+	mesh_ = -1;
+	num_steps_ = 0;
+
+	const std::string xmffilename = prefix_ + ".xmf";
+	fd_ = ::open(xmffilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd_ < 0) {
+		printf("Could not open %s for writing.\n", xmffilename.c_str());
+		return -1;
+	}
+
+	footer_offset_ = sizeof(XDMF_HEADER) - 1;
+	if (!pwrite_all(fd_, std::string(XDMF_HEADER) + XDMF_FOOTER, 0)) {
+		printf("Error while writing %s.\n", xmffilename.c_str());
+		close();
+		return -1;
+	}
+	return 0;
+}
+
+void XdmfSeries::close() {
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+int XdmfSeries::write_mesh(const GRID &g) {
+	if (fd_ < 0) {
+		printf("No xmf file open.\n");
+		return -1;
+	}
+
+	const int mesh = mesh_ + 1;
+	std::ostringstream name;
+	name << prefix_ << "_mesh" << mesh;
+
+	const count_t nn = g.num_nodes();
+	const count_t nt = g.num_triangles();
+	// the arrays of the GRID are written as they are
+	if (write_heavy_data(name.str() + "_x.bin", g.coordinates(0), nn * sizeof(double)) != 0
+	    || write_heavy_data(name.str() + "_y.bin", g.coordinates(1), nn * sizeof(double)) != 0
+	    || write_heavy_data(name.str() + "_conn.bin", g.triangles(), nt * sizeof(Triangle)) != 0) {
+		return -1;
+	}
+
+	mesh_ = mesh;
+	num_nodes_ = nn;
+	num_triangles_ = nt;
+	return 0;
+}
+
+int XdmfSeries::write(const FE_VEC u[], int n_vectors, double time) {
+	if (fd_ < 0 || mesh_ < 0) {
+		printf("No xmf file open or no mesh written.\n");
+		return -1;
+	}
+	for(int k = 0; k < n_vectors; k++) {
+		if (num_nodes_ != u[k].length()) {
+			std::cout << "Mesh (" << num_nodes_ << " nodes) and fe vector " << k << " (length " << u[k].length() << ") do not match!" << std::endl;
+			return -1;
+		}
+	}
+
+	// point data of all FE_VECs in one file
+	const int step = num_steps_;
+	std::ostringstream suffix;
+	suffix << "_" << step << ".bin";
+	const std::string filename = prefix_ + suffix.str();
+	const std::string data_name = base_ + suffix.str();
+	{
+		FILE *fp;
+		if ((fp = fopen(filename.c_str(), "wb")) == NULL) {
+			printf("Could not open %s for writing.\n", filename.c_str());
+			return -1;
+		}
+		bool ok = true;
+		for(int k = 0; k < n_vectors; k++) {
+			ok = ok && (num_nodes_ == 0 || fwrite(u[k].getValues().data(), sizeof(double), num_nodes_, fp) == static_cast<size_t>(num_nodes_));
+		}
+		if (fclose(fp) != 0 || !ok) {
+			printf("Error while writing %s.\n", filename.c_str());
+			return -1;
+		}
+	}
+
+	std::ostringstream mesh_name;
+	mesh_name << base_ << "_mesh" << mesh_;
+	std::ostringstream nn, nt;
+	nn << num_nodes_;
+	nt << num_triangles_ << " " << NODES_PER_TRIANGLE;
+
+	// light data of the time step, written as one block together with the footer
+	std::ostringstream xml;
+	xml.precision(15);
+	xml << "\t<Grid Name=\"step_" << step << "\" GridType=\"Uniform\">\n";
+	xml << "\t\t<Time Value=\"" << time << "\"/>\n";
+	xml << "\t\t<Topology TopologyType=\"Triangle\" NumberOfElements=\"" << num_triangles_ << "\">\n";
+	data_item(xml, "\t\t\t", nt.str(), "Int", sizeof(index_t), mesh_name.str() + "_conn.bin", 0);
+	xml << "\t\t</Topology>\n";
+	xml << "\t\t<Geometry GeometryType=\"X_Y\">\n";
+	data_item(xml, "\t\t\t", nn.str(), "Float", sizeof(double), mesh_name.str() + "_x.bin", 0);
+	data_item(xml, "\t\t\t", nn.str(), "Float", sizeof(double), mesh_name.str() + "_y.bin", 0);
+	xml << "\t\t</Geometry>\n";
+	for(int k = 0; k < n_vectors; k++) {
+		xml << "\t\t<Attribute Name=\"" << u[k].getName() << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
+		data_item(xml, "\t\t\t", nn.str(), "Float", sizeof(double), data_name, k * num_nodes_ * sizeof(double));
+		xml << "\t\t</Attribute>\n";
+	}
+	xml << "\t</Grid>\n";
+
+	const std::string entry = xml.str();
+	if (!pwrite_all(fd_, entry + XDMF_FOOTER, footer_offset_)) {
+		printf("Error while writing %s.xmf.\n", prefix_.c_str());
+		return -1;
+	}
+	footer_offset_ += entry.size();
+	++num_steps_;
+	return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef _XDMF_SERIES_H_
+#define _XDMF_SERIES_H_
+
+#include <string>
+
+#include "grid.h"
+#include "FE_VEC.h"
+
+/// @brief Time series of point data in XDMF format with raw binary heavy
+/// data files (use e.g. ParaView to view the .xmf file)
+/// The geometry and connectivity of a GRID are written only once by
+/// write_mesh(); all following time steps written by write() refer to
+/// these files and only store their point data. Like PvdCollection, the
+/// .xmf file stays open and is complete after every time step.
+///
+/// Files for prefix "data/run":
+///   - data/run.xmf: light data (XML)
+///   - data/run_mesh<m>_x.bin, ..._y.bin: coordinates of mesh m (Float64)
+///   - data/run_mesh<m>_conn.bin: triangles of mesh m (index_t)
+///   - data/run_<step>.bin: point data of time step step, one array of
+///     Float64 per FE_VEC
+class XdmfSeries {
+private:
+	/// File descriptor of the .xmf file, -1 if not open
+	int fd_;
+
+	/// Prefix for the file names, see open()
+	std::string prefix_;
+
+	/// prefix_ without directory, used to reference the heavy data files
+	std::string base_;
+
+	/// Position of the footer in the .xmf file
+	long footer_offset_;
+
+	/// Number of the current mesh, -1 if no mesh has been written
+	int mesh_;
+
+	/// Number of nodes and triangles of the current mesh
+	count_t num_nodes_;
+	count_t num_triangles_;
+
+	/// Number of time steps written so far
+	int num_steps_;
+
+	XdmfSeries(const XdmfSeries&);
+	XdmfSeries& operator=(const XdmfSeries&);
+
+public:
+	/// Constructor, no file is opened
+	XdmfSeries();
+
+	/// Destructor, closes the .xmf file
+	~XdmfSeries();
+
+	/// Create prefix.xmf with an empty time series
+	/// An existing file is overwritten.
+	/// @return 0 on success, -1 otherwise
+	int open(const char* prefix);
+
+	/// Close the .xmf file
+	void close();
+
+	/// Write coordinates and connectivity of g; the following time steps
+	/// are defined on g until write_mesh() is called again
+	/// @return 0 on success, -1 otherwise
+	int write_mesh(const GRID &g);
+
+	/// Write FE_VECs on the current mesh as next time step
+	/// @param vectors FE_VECs which data shall be visualized
+	/// @param n_vectors length of vectors
+	/// @param time (physical/simulated) time of the time-step
+	/// @return 0 on success, -1 otherwise
+	int write(const FE_VEC vectors[], int n_vectors, double time);
+};
+
+#endif